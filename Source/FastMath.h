@@ -0,0 +1,89 @@
+/*
+  ==============================================================================
+
+    FastMath.h
+    Created: 17 Oct 2026 5:44:37am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Approximations for updating the coefficients of many modes at once.  They
+// have no branches or library calls, so the compiler can vectorize the loops
+// that use them, and they are accurate to about the rounding of a float.
+namespace FastMath {
+
+// exp(x) for x <= 0, never above one.  x is first clamped to [-87, 0], an
+// infinity or NaN by its sign.
+inline float expNonPositive(float x)
+{
+    constexpr float log2e = 1.44269504f;
+    constexpr float ln2Hi = 0.693145752f;
+    constexpr float ln2Lo = 1.42860677e-6f;
+    // Clamp x to [-87, 0], so that converting k to int is always defined.
+    // A compare on x as a float stops GCC vectorizing, so this works on its
+    // bits: those of a negative float grow with its magnitude, and infinity
+    // and NaN come after every finite value of the same sign.
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    constexpr uint32_t signBit = 0x80000000u;
+    constexpr uint32_t minus87 = 0xc2ae0000u;
+    bits = bits < signBit ? 0u : bits;
+    bits = std::min(bits, minus87);
+    std::memcpy(&x, &bits, sizeof(x));
+    // x = k ln 2 + f, with |f| <= ln 2 / 2
+    const int k = (int) (x * log2e - 0.5f);
+    const float f = (x - (float) k * ln2Hi) - (float) k * ln2Lo;
+    float p = 1.0f / 720.0f;
+    p = p * f + 1.0f / 120.0f;
+    p = p * f + 1.0f / 24.0f;
+    p = p * f + 1.0f / 6.0f;
+    p = p * f + 0.5f;
+    p = p * f + 1.0f;
+    p = p * f + 1.0f;
+    // 2^k, built from its exponent bits; k is at least -126, so 2^k is normal
+    const int scaleBits = (k + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &scaleBits, sizeof(scale));
+    return std::min(1.0f, p * scale);
+}
+
+// The unit phasor exp(i x), for |x| up to a few turns
+inline void unitPhasor(float x, float &re, float &im)
+{
+    constexpr float invTwoPi = 0.159154943f;
+    constexpr float twoPiHi = 6.28318548f;
+    constexpr float twoPiLo = -1.74845553e-7f;
+    const float turns = x * invTwoPi;
+    const int k = (int) (turns + (turns >= 0.0f ? 0.5f : -0.5f));
+    // sin and cos of half the reduced angle, |h| <= pi / 2, by Taylor series
+    const float h = 0.5f * ((x - (float) k * twoPiHi) - (float) k * twoPiLo);
+    const float h2 = h * h;
+    float s = -1.0f / 39916800.0f;
+    s = s * h2 + 1.0f / 362880.0f;
+    s = s * h2 - 1.0f / 5040.0f;
+    s = s * h2 + 1.0f / 120.0f;
+    s = s * h2 - 1.0f / 6.0f;
+    s = (s * h2 + 1.0f) * h;
+    float c = 1.0f / 479001600.0f;
+    c = c * h2 - 1.0f / 3628800.0f;
+    c = c * h2 + 1.0f / 40320.0f;
+    c = c * h2 - 1.0f / 720.0f;
+    c = c * h2 + 1.0f / 24.0f;
+    c = c * h2 - 0.5f;
+    c = c * h2 + 1.0f;
+    // double the angle, then pull the result back onto the unit circle, so
+    // that an undamped mode neither grows nor decays
+    re = c * c - s * s;
+    im = 2.0f * s * c;
+    const float norm = re * re + im * im;
+    const float correction = 1.5f - 0.5f * norm;
+    re *= correction;
+    im *= correction;
+}
+
+}
@@ -0,0 +1,46 @@
+/*
+  ==============================================================================
+
+    LoadMonitor.cpp
+    Created: 17 Oct 2026 4:38:47am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#include "LoadMonitor.h"
+
+LoadMonitor::LoadMonitor() :
+    startTicks(juce::Time::getHighResolutionTicks()),
+    secondsPerTick(1.0 / (double) juce::Time::getHighResolutionTicksPerSecond())
+{}
+
+float LoadMonitor::endBlock(int numSamples, double sampleRate, int activeVoices, int activeModes,
+                            int lowestNote, int highestNote, int modeLimit) noexcept
+{
+    const auto endTicks = juce::Time::getHighResolutionTicks();
+    const double renderSeconds = (double) (endTicks - blockStartTicks) * secondsPerTick;
+    const double deadline = sampleRate > 0.0 ? numSamples / sampleRate : 0.0;
+    const float load = deadline > 0.0 ? (float) (renderSeconds / deadline) : 0.0f;
+
+    ++numBlocks;
+    if (load > 1.0f) {
+        ++numOverruns;
+    }
+
+    const auto scope = fifo.write(1);
+    if (scope.blockSize1 > 0) {
+        stats[(size_t) scope.startIndex1] = { (double) (blockStartTicks - startTicks) * secondsPerTick,
+                                              (float) (renderSeconds * 1000.0), load, numSamples,
+                                              activeVoices, activeModes, lowestNote, highestNote, modeLimit };
+    }
+    return load;
+}
+
+int LoadMonitor::readStats(BlockStats *dest, int maxBlocks) noexcept
+{
+    const auto scope = fifo.read(juce::jmin(maxBlocks, fifo.getNumReady()));
+    std::copy_n(stats.begin() + scope.startIndex1, scope.blockSize1, dest);
+    std::copy_n(stats.begin() + scope.startIndex2, scope.blockSize2, dest + scope.blockSize1);
+    return scope.blockSize1 + scope.blockSize2;
+}
@@ -0,0 +1,59 @@
+/*
+  ==============================================================================
+
+    LoadMonitor.h
+    Created: 17 Oct 2026 4:38:47am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Per-block DSP load statistics, recorded on the audio thread and read by the
+// editor.  Recording a block costs two clock reads and a lock-free FIFO
+// write; if nothing is reading, the newest blocks are dropped.
+class LoadMonitor {
+public:
+    struct BlockStats {
+        double time;        // seconds since the monitor was created
+        float renderMs;     // time spent in processBlock
+        float load;         // fraction of the block's real-time deadline used
+        int numSamples;
+        int activeVoices;
+        int activeModes;
+        int lowestNote;     // -1 if no voice is active
+        int highestNote;
+        int modeLimit;      // modes each voice was allowed
+    };
+
+    LoadMonitor();
+
+    // Audio thread: bracket the work done for each block.  endBlock returns
+    // the block's load.
+    void beginBlock() noexcept { blockStartTicks = juce::Time::getHighResolutionTicks(); }
+    float endBlock(int numSamples, double sampleRate, int activeVoices, int activeModes,
+                   int lowestNote, int highestNote, int modeLimit) noexcept;
+
+    // Single reader: copy out up to maxBlocks pending stats, oldest first
+    int readStats(BlockStats *dest, int maxBlocks) noexcept;
+
+    juce::int64 getNumBlocks() const noexcept { return numBlocks.load(); }
+    juce::int64 getNumOverruns() const noexcept { return numOverruns.load(); }
+
+    static constexpr int capacity = 4096;
+
+private:
+    juce::AbstractFifo fifo { capacity };
+    std::array<BlockStats, capacity> stats;
+    std::atomic<juce::int64> numBlocks { 0 };
+    std::atomic<juce::int64> numOverruns { 0 };
+
+    const juce::int64 startTicks;
+    const double secondsPerTick;
+    juce::int64 blockStartTicks = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (LoadMonitor)
+};
@@ -0,0 +1,548 @@
+/*
+  ==============================================================================
+
+    ModalBank.cpp
+    Created: 17 Oct 2026 4:24:18am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#include "ModalBank.h"
+
+#if (defined (__x86_64__) || defined (_M_X64)) && (defined (__GNUC__) || defined (__clang__))
+ #define STIFFSTRING_X86_SIMD 1
+ #include <immintrin.h>
+#else
+ #define STIFFSTRING_X86_SIMD 0
+#endif
+
+namespace {
+
+using Buffers = ModalBank::Buffers;
+using Output = ModalBank::Output;
+using Span = ModalBank::Span;
+
+// The kernels sweep every mode across a sub-block of samples, holding the mode
+// state in registers, before moving to the next group of modes.  The vector
+// kernels accumulate one SIMD register of partial sums per sample and pickup
+// into a small scratch buffer, and only reduce across lanes once per sample,
+// after all modes have been swept.  The scratch buffer is the same size
+// whatever the number of pickups, so the sub-blocks get shorter as pickups
+// are added.
+//
+// Each step of a mode depends on the last, so a single mode (or vector of
+// modes) is limited by the latency of a complex multiply.  The sweeps are
+// templated on the number of blocks of vectorSize modes advanced side by side,
+// so that the compiler unrolls them into independent chains and keeps them in
+// registers.  The blocks of a tile need not be adjacent: the modes to sweep
+// are given as a list of spans, and tiles are gathered across the spans, so
+// that many short spans (the modes of many voices) fill the tiles as well as
+// one long one.  The bulk goes tileSize blocks at a time, and the remainder
+// two or one at a time.  They are also templated on the number of pickups,
+// so that each pickup is one more multiply-add per mode in the inner loop.
+//
+// When Ramp is true, each weight also moves by weightStep every sample.  When
+// Driven is true, each mode's real part also takes drive times the input
+// after every step, the input being the same for every mode.
+constexpr int subBlockSize = 256;
+constexpr int vectorSize = ModalBank::vectorSize;
+constexpr int maxPickups = ModalBank::maxPickups;
+
+template <int TileSize, typename Sweep>
+inline void forEachTile(const Span *spans, int numSpans, Sweep &&sweep)
+{
+    int starts[TileSize];
+    int count = 0;
+    for (int k = 0; k < numSpans; ++k) {
+        const int end = spans[k].begin + spans[k].numModes;
+        for (int i = spans[k].begin; i < end; i += vectorSize) {
+            starts[count++] = i;
+            if (count == TileSize) {
+                sweep(std::integral_constant<int, TileSize>(), starts);
+                count = 0;
+            }
+        }
+    }
+    int done = 0;
+    if (TileSize > 2 && count - done >= 2) {
+        sweep(std::integral_constant<int, 2>(), starts + done);
+        done += 2;
+    }
+    for (; done < count; ++done) {
+        sweep(std::integral_constant<int, 1>(), starts + done);
+    }
+}
+
+// sum holds each pickup's samples in turn, stride apart
+inline void writeOutput(const Output &out, int start, const float *sum, int stride, int numPickups,
+                        int numSamples)
+{
+    for (int ch = 0; ch < out.numChannels; ++ch) {
+        float *dest = out.channels[ch] + out.offset + start;
+        const float *src = sum + (ch % numPickups) * stride;
+        if (out.accumulate) {
+            for (int s = 0; s < numSamples; ++s) {
+                dest[s] += out.gain * src[s];
+            }
+        } else {
+            for (int s = 0; s < numSamples; ++s) {
+                dest[s] = out.gain * src[s];
+            }
+        }
+    }
+}
+
+template <int Tile, int Pickups, bool Ramp, bool Driven>
+inline void sweepScalar(const Buffers &b, int i, const float *input, float *sum, int stride, int n)
+{
+    static_assert(vectorSize % Tile == 0, "tiles must fill whole blocks");
+    float zr[Tile], zi[Tile], cr[Tile], ci[Tile], d[Tile], w[Pickups][Tile], dw[Pickups][Tile];
+    for (int g = 0; g < Tile; ++g) {
+        zr[g] = b.re[i + g];
+        zi[g] = b.im[i + g];
+        cr[g] = b.coefRe[i + g];
+        ci[g] = b.coefIm[i + g];
+        d[g] = Driven ? b.drive[i + g] : 0.0f;
+        for (int p = 0; p < Pickups; ++p) {
+            w[p][g] = b.weight[p][i + g];
+            dw[p][g] = b.weightStep[p][i + g];
+        }
+    }
+    for (int s = 0; s < n; ++s) {
+        for (int p = 0; p < Pickups; ++p) {
+            float total = sum[p * stride + s];
+            for (int g = 0; g < Tile; ++g) {
+                total += w[p][g] * zi[g];
+                if (Ramp) {
+                    w[p][g] += dw[p][g];
+                }
+            }
+            sum[p * stride + s] = total;
+        }
+        for (int g = 0; g < Tile; ++g) {
+            const float tmp = cr[g] * zr[g] - ci[g] * zi[g];
+            zi[g] = cr[g] * zi[g] + ci[g] * zr[g];
+            zr[g] = Driven ? tmp + d[g] * input[s] : tmp;
+        }
+    }
+    for (int g = 0; g < Tile; ++g) {
+        b.re[i + g] = zr[g];
+        b.im[i + g] = zi[g];
+        if (Ramp) {
+            for (int p = 0; p < Pickups; ++p) {
+                b.weight[p][i + g] = w[p][g];
+            }
+        }
+    }
+}
+
+template <int Pickups, bool Ramp, bool Driven>
+void processScalar(const Buffers &b, const Span *spans, int numSpans, const Output &out, int numSamples)
+{
+    constexpr int blockSize = subBlockSize / Pickups;
+    float sum[Pickups * blockSize];
+
+    for (int start = 0; start < numSamples; start += blockSize) {
+        const int n = std::min(blockSize, numSamples - start);
+        const float *input = Driven ? out.input + out.offset + start : nullptr;
+        std::fill(sum, sum + Pickups * blockSize, 0.0f);
+        // a block at a time, four modes side by side
+        forEachTile<1>(spans, numSpans, [&](auto, const int *starts) {
+            for (int g = 0; g < vectorSize; g += 4) {
+                sweepScalar<4, Pickups, Ramp, Driven>(b, starts[0] + g, input, sum, blockSize, n);
+            }
+        });
+        writeOutput(out, start, sum, blockSize, Pickups, n);
+    }
+}
+
+#if STIFFSTRING_X86_SIMD
+// Each block of eight modes is two SSE vectors
+template <int Tile, int Pickups, bool Ramp, bool Driven>
+inline void sweepSSE2(const Buffers &b, const int *starts, const float *input, float *acc, int n)
+{
+    constexpr int numVectors = 2 * Tile;
+    __m128 zr[numVectors], zi[numVectors], cr[numVectors], ci[numVectors], d[numVectors];
+    __m128 w[Pickups][numVectors], dw[Pickups][numVectors];
+    for (int g = 0; g < numVectors; ++g) {
+        const int j = starts[g / 2] + 4 * (g % 2);
+        zr[g] = _mm_loadu_ps(b.re + j);
+        zi[g] = _mm_loadu_ps(b.im + j);
+        cr[g] = _mm_loadu_ps(b.coefRe + j);
+        ci[g] = _mm_loadu_ps(b.coefIm + j);
+        d[g] = Driven ? _mm_loadu_ps(b.drive + j) : _mm_setzero_ps();
+        for (int p = 0; p < Pickups; ++p) {
+            w[p][g] = _mm_loadu_ps(b.weight[p] + j);
+            dw[p][g] = _mm_loadu_ps(b.weightStep[p] + j);
+        }
+    }
+    for (int s = 0; s < n; ++s) {
+        for (int p = 0; p < Pickups; ++p) {
+            float *a = acc + 4 * (s * Pickups + p);
+            __m128 total = _mm_load_ps(a);
+            for (int g = 0; g < numVectors; ++g) {
+                total = _mm_add_ps(total, _mm_mul_ps(w[p][g], zi[g]));
+                if (Ramp) {
+                    w[p][g] = _mm_add_ps(w[p][g], dw[p][g]);
+                }
+            }
+            _mm_store_ps(a, total);
+        }
+        const __m128 u = Driven ? _mm_set1_ps(input[s]) : _mm_setzero_ps();
+        for (int g = 0; g < numVectors; ++g) {
+            const __m128 tmp = _mm_sub_ps(_mm_mul_ps(cr[g], zr[g]), _mm_mul_ps(ci[g], zi[g]));
+            zi[g] = _mm_add_ps(_mm_mul_ps(cr[g], zi[g]), _mm_mul_ps(ci[g], zr[g]));
+            zr[g] = Driven ? _mm_add_ps(tmp, _mm_mul_ps(d[g], u)) : tmp;
+        }
+    }
+    for (int g = 0; g < numVectors; ++g) {
+        const int j = starts[g / 2] + 4 * (g % 2);
+        _mm_storeu_ps(b.re + j, zr[g]);
+        _mm_storeu_ps(b.im + j, zi[g]);
+        if (Ramp) {
+            for (int p = 0; p < Pickups; ++p) {
+                _mm_storeu_ps(b.weight[p] + j, w[p][g]);
+            }
+        }
+    }
+}
+
+template <int Pickups, bool Ramp, bool Driven>
+void processSSE2(const Buffers &b, const Span *spans, int numSpans, const Output &out, int numSamples)
+{
+    constexpr int blockSize = subBlockSize / Pickups;
+    alignas(16) float acc[Pickups * blockSize * 4];
+    alignas(16) float sum[Pickups * blockSize];
+
+    for (int start = 0; start < numSamples; start += blockSize) {
+        const int n = std::min(blockSize, numSamples - start);
+        const float *input = Driven ? out.input + out.offset + start : nullptr;
+        for (int r = 0; r < Pickups * n; ++r) {
+            _mm_store_ps(acc + 4 * r, _mm_setzero_ps());
+        }
+
+        forEachTile<2>(spans, numSpans, [&](auto tile, const int *starts) {
+            sweepSSE2<decltype(tile)::value, Pickups, Ramp, Driven>(b, starts, input, acc, n);
+        });
+
+        for (int p = 0; p < Pickups; ++p) {
+            const auto row = [&](int s) { return acc + 4 * (s * Pickups + p); };
+            float *dest = sum + p * blockSize;
+            int s = 0;
+            for (; s + 4 <= n; s += 4) {
+                __m128 r0 = _mm_load_ps(row(s));
+                __m128 r1 = _mm_load_ps(row(s + 1));
+                __m128 r2 = _mm_load_ps(row(s + 2));
+                __m128 r3 = _mm_load_ps(row(s + 3));
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                _mm_storeu_ps(dest + s, _mm_add_ps(_mm_add_ps(r0, r1), _mm_add_ps(r2, r3)));
+            }
+            for (; s < n; ++s) {
+                const float *a = row(s);
+                dest[s] = (a[0] + a[1]) + (a[2] + a[3]);
+            }
+        }
+        writeOutput(out, start, sum, blockSize, Pickups, n);
+    }
+}
+
+template <int Tile, int Pickups, bool Ramp, bool Driven>
+__attribute__((target("avx2,fma")))
+inline void sweepAVX2(const Buffers &b, const int *starts, const float *input, float *acc, int n)
+{
+    __m256 zr[Tile], zi[Tile], cr[Tile], ci[Tile], d[Tile], w[Pickups][Tile], dw[Pickups][Tile];
+    for (int g = 0; g < Tile; ++g) {
+        const int j = starts[g];
+        zr[g] = _mm256_loadu_ps(b.re + j);
+        zi[g] = _mm256_loadu_ps(b.im + j);
+        cr[g] = _mm256_loadu_ps(b.coefRe + j);
+        ci[g] = _mm256_loadu_ps(b.coefIm + j);
+        d[g] = Driven ? _mm256_loadu_ps(b.drive + j) : _mm256_setzero_ps();
+        for (int p = 0; p < Pickups; ++p) {
+            w[p][g] = _mm256_loadu_ps(b.weight[p] + j);
+            dw[p][g] = _mm256_loadu_ps(b.weightStep[p] + j);
+        }
+    }
+    for (int s = 0; s < n; ++s) {
+        for (int p = 0; p < Pickups; ++p) {
+            float *a = acc + 8 * (s * Pickups + p);
+            __m256 total = _mm256_load_ps(a);
+            for (int g = 0; g < Tile; ++g) {
+                total = _mm256_fmadd_ps(w[p][g], zi[g], total);
+                if (Ramp) {
+                    w[p][g] = _mm256_add_ps(w[p][g], dw[p][g]);
+                }
+            }
+            _mm256_store_ps(a, total);
+        }
+        const __m256 u = Driven ? _mm256_set1_ps(input[s]) : _mm256_setzero_ps();
+        for (int g = 0; g < Tile; ++g) {
+            const __m256 tmp = _mm256_fmsub_ps(cr[g], zr[g], _mm256_mul_ps(ci[g], zi[g]));
+            zi[g] = _mm256_fmadd_ps(cr[g], zi[g], _mm256_mul_ps(ci[g], zr[g]));
+            zr[g] = Driven ? _mm256_fmadd_ps(d[g], u, tmp) : tmp;
+        }
+    }
+    for (int g = 0; g < Tile; ++g) {
+        const int j = starts[g];
+        _mm256_storeu_ps(b.re + j, zr[g]);
+        _mm256_storeu_ps(b.im + j, zi[g]);
+        if (Ramp) {
+            for (int p = 0; p < Pickups; ++p) {
+                _mm256_storeu_ps(b.weight[p] + j, w[p][g]);
+            }
+        }
+    }
+}
+
+template <int Pickups, bool Ramp, bool Driven>
+__attribute__((target("avx2,fma")))
+void processAVX2(const Buffers &b, const Span *spans, int numSpans, const Output &out, int numSamples)
+{
+    constexpr int blockSize = subBlockSize / Pickups;
+    alignas(32) float acc[Pickups * blockSize * 8];
+    alignas(32) float sum[Pickups * blockSize];
+
+    for (int start = 0; start < numSamples; start += blockSize) {
+        const int n = std::min(blockSize, numSamples - start);
+        const float *input = Driven ? out.input + out.offset + start : nullptr;
+        for (int r = 0; r < Pickups * n; ++r) {
+            _mm256_store_ps(acc + 8 * r, _mm256_setzero_ps());
+        }
+
+        forEachTile<4>(spans, numSpans, [&](auto tile, const int *starts) {
+            sweepAVX2<decltype(tile)::value, Pickups, Ramp, Driven>(b, starts, input, acc, n);
+        });
+
+        // reduce eight rows of partial sums at a time
+        for (int p = 0; p < Pickups; ++p) {
+            const auto row = [&](int s) { return acc + 8 * (s * Pickups + p); };
+            float *dest = sum + p * blockSize;
+            int s = 0;
+            for (; s + 8 <= n; s += 8) {
+                const __m256 t0 = _mm256_hadd_ps(_mm256_load_ps(row(s)), _mm256_load_ps(row(s + 1)));
+                const __m256 t1 = _mm256_hadd_ps(_mm256_load_ps(row(s + 2)), _mm256_load_ps(row(s + 3)));
+                const __m256 t2 = _mm256_hadd_ps(_mm256_load_ps(row(s + 4)), _mm256_load_ps(row(s + 5)));
+                const __m256 t3 = _mm256_hadd_ps(_mm256_load_ps(row(s + 6)), _mm256_load_ps(row(s + 7)));
+                const __m256 lo = _mm256_hadd_ps(t0, t1);
+                const __m256 hi = _mm256_hadd_ps(t2, t3);
+                const __m256 total = _mm256_add_ps(_mm256_permute2f128_ps(lo, hi, 0x20),
+                                                   _mm256_permute2f128_ps(lo, hi, 0x31));
+                _mm256_storeu_ps(dest + s, total);
+            }
+            for (; s < n; ++s) {
+                const float *a = row(s);
+                dest[s] = ((a[0] + a[1]) + (a[2] + a[3])) + ((a[4] + a[5]) + (a[6] + a[7]));
+            }
+        }
+        writeOutput(out, start, sum, blockSize, Pickups, n);
+    }
+}
+#endif
+
+// Fill in a kernel's tables from select(pickups, ramp, driven), which gives
+// each specialization
+template <typename Select, size_t... Index>
+ModalBank::Kernel makeKernel(Select select, const char *name, std::index_sequence<Index...>)
+{
+    ModalBank::Kernel kernel {};
+    const auto fill = [&](auto ramp, auto driven) {
+        ((kernel.process[ramp][driven][Index] = select(std::integral_constant<int, (int) Index + 1>(), ramp, driven)),
+         ...);
+    };
+    fill(std::false_type(), std::false_type());
+    fill(std::false_type(), std::true_type());
+    fill(std::true_type(), std::false_type());
+    fill(std::true_type(), std::true_type());
+    kernel.name = name;
+    return kernel;
+}
+
+template <typename Select>
+ModalBank::Kernel makeKernel(Select select, const char *name)
+{
+    return makeKernel(select, name, std::make_index_sequence<maxPickups>());
+}
+
+ModalBank::Kernel selectKernel()
+{
+#if STIFFSTRING_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return makeKernel([](auto pickups, auto ramp, auto driven) {
+            return &processAVX2<decltype(pickups)::value, decltype(ramp)::value, decltype(driven)::value>;
+        }, "AVX2");
+    }
+    return makeKernel([](auto pickups, auto ramp, auto driven) {
+        return &processSSE2<decltype(pickups)::value, decltype(ramp)::value, decltype(driven)::value>;
+    }, "SSE2");
+#else
+    return makeKernel([](auto pickups, auto ramp, auto driven) {
+        return &processScalar<decltype(pickups)::value, decltype(ramp)::value, decltype(driven)::value>;
+    }, "scalar");
+#endif
+}
+
+const ModalBank::Kernel &getKernel()
+{
+    static const ModalBank::Kernel kernel = selectKernel();
+    return kernel;
+}
+
+}
+
+ModalBank::ModalBank(int maxModes, int numPickups, float *storage) :
+    maxModes(maxModes),
+    paddedSize((int) getPaddedSize(maxModes)),
+    numModes(maxModes),
+    kernel(getKernel())
+{
+    jassert(maxModes > 0);
+    jassert(numPickups >= 1 && numPickups <= maxPickups);
+    static_assert(VoiceArena::floatsPerCacheLine % vectorSize == 0, "padding must fill whole vectors");
+    std::fill(storage, storage + getStorageSize(maxModes, numPickups), 0.0f);
+    buffers = {};
+    buffers.numPickups = numPickups;
+    buffers.re = storage;
+    buffers.im = buffers.re + paddedSize;
+    buffers.coefRe = buffers.im + paddedSize;
+    buffers.coefIm = buffers.coefRe + paddedSize;
+    buffers.drive = buffers.coefIm + paddedSize;
+    float *next = buffers.drive + paddedSize;
+    for (int p = 0; p < numPickups; ++p) {
+        buffers.weight[p] = next;
+        buffers.weightStep[p] = next + paddedSize;
+        weightTarget[p] = next + 2 * paddedSize;
+        next += 3 * paddedSize;
+    }
+}
+
+void ModalBank::setNumModes(int newNumModes)
+{
+    jassert(newNumModes >= 0 && newNumModes <= maxModes);
+    // silence the padding, so the kernels can run over it
+    for (int i = newNumModes; i < paddedSize; ++i) {
+        buffers.re[i] = buffers.im[i] = 0.0f;
+        buffers.coefRe[i] = buffers.coefIm[i] = buffers.drive[i] = 0.0f;
+        for (int p = 0; p < buffers.numPickups; ++p) {
+            buffers.weight[p][i] = buffers.weightStep[p][i] = weightTarget[p][i] = 0.0f;
+        }
+    }
+    numModes = newNumModes;
+}
+
+void ModalBank::removeMode(int i)
+{
+    jassert(i >= 0 && i < numModes);
+    const int last = numModes - 1;
+    const auto move = [i, last](float *a) {
+        a[i] = a[last];
+        a[last] = 0.0f;
+    };
+    for (float *a : { buffers.re, buffers.im, buffers.coefRe, buffers.coefIm, buffers.drive }) {
+        move(a);
+    }
+    for (int p = 0; p < buffers.numPickups; ++p) {
+        move(buffers.weight[p]);
+        move(buffers.weightStep[p]);
+        move(weightTarget[p]);
+    }
+    numModes = last;
+}
+
+void ModalBank::setCoefficient(int i, float radius, float omega)
+{
+    buffers.coefRe[i] = radius * std::cos(omega);
+    buffers.coefIm[i] = radius * std::sin(omega);
+}
+
+void ModalBank::setWeight(int i, int pickup, float newWeight)
+{
+    buffers.weight[pickup][i] = weightTarget[pickup][i] = newWeight;
+    buffers.weightStep[pickup][i] = 0.0f;
+}
+
+void ModalBank::startWeightRamp(int numSamples)
+{
+    rampSamplesRemaining = juce::jmax(0, numSamples);
+    if (rampSamplesRemaining == 0) {
+        finishWeightRamp();
+        return;
+    }
+    const float scale = 1.0f / rampSamplesRemaining;
+    for (int p = 0; p < buffers.numPickups; ++p) {
+        for (int i = 0; i < numModes; ++i) {
+            buffers.weightStep[p][i] = (weightTarget[p][i] - buffers.weight[p][i]) * scale;
+        }
+    }
+}
+
+void ModalBank::finishWeightRamp()
+{
+    for (int p = 0; p < buffers.numPickups; ++p) {
+        for (int i = 0; i < numModes; ++i) {
+            buffers.weight[p][i] = weightTarget[p][i];
+            buffers.weightStep[p][i] = 0.0f;
+        }
+    }
+    rampSamplesRemaining = 0;
+}
+
+float ModalBank::getNextSample()
+{
+    float sample;
+    float *dest = &sample;
+    process({ &dest, 1, 0, 1.0f, false }, 1);
+    return sample;
+}
+
+void ModalBank::renderBlock(float *dest, int numSamples)
+{
+    process({ &dest, 1, 0, 1.0f, false }, numSamples);
+}
+
+void ModalBank::addBlock(float *const *dest, int numChannels, int numSamples, float gain, const float *input)
+{
+    process({ dest, numChannels, 0, gain, true, input }, numSamples);
+}
+
+void ModalBank::process(Output out, int numSamples)
+{
+    const Span span { 0, getPaddedNumModes() };
+    const int numPickups = buffers.numPickups;
+    const bool driven = out.input != nullptr;
+    if (rampSamplesRemaining > 0) {
+        const int n = juce::jmin(numSamples, rampSamplesRemaining);
+        kernel.get(numPickups, true, driven)(buffers, &span, 1, out, n);
+        advanceRamp(n);
+        out.offset += n;
+        numSamples -= n;
+    }
+    if (numSamples > 0) {
+        kernel.get(numPickups, false, driven)(buffers, &span, 1, out, numSamples);
+    }
+}
+
+ModalBank::Span ModalBank::getSpan(const ModalBank &base) const
+{
+    // the same offset must reach this bank in every one of base's arrays
+    jassert(paddedSize == base.paddedSize && buffers.numPickups == base.buffers.numPickups);
+    const auto begin = buffers.re - base.buffers.re;
+    jassert(begin % vectorSize == 0 && begin <= std::numeric_limits<int>::max());
+    return { (int) begin, getPaddedNumModes() };
+}
+
+void ModalBank::advanceRamp(int numSamples)
+{
+    jassert(numSamples <= rampSamplesRemaining);
+    rampSamplesRemaining -= numSamples;
+    if (rampSamplesRemaining == 0) {
+        finishWeightRamp();
+    }
+}
+
+void ModalBank::process(const Buffers &buffers, const Span *spans, int numSpans, const Output &out,
+                        int numSamples, bool ramp)
+{
+    getKernel().get(buffers.numPickups, ramp, out.input != nullptr)(buffers, spans, numSpans, out, numSamples);
+}
@@ -0,0 +1,177 @@
+/*
+  ==============================================================================
+
+    ModalBank.h
+    Created: 17 Oct 2026 4:24:18am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "VoiceArena.h"
+
+// A bank of exponentially damped sinusoids.  Each mode is a complex phasor z,
+// advanced once per sample by z <- c * z with c = r * exp(i * omega), so decay
+// and oscillation happen in a single complex multiply.  The bank has one or
+// more pickups, each with its own weight for every mode, and the output of a
+// pickup is the sum over modes of its weight * Im(z).  All the pickups are
+// summed in the same pass over the modes, so each extra pickup costs a
+// multiply-add per mode rather than another pass.
+//
+// The modes may also be driven by an input signal u, each through a drive
+// weight d of its own: z <- c * z + d * u.  The input is shared by every
+// mode, so driving them costs one more multiply-add per mode per sample, in
+// the same pass.
+//
+// The state is stored as structure-of-arrays, in storage owned by the caller
+// (see VoiceArena).  Each array is padded to a whole number of cache lines,
+// so the kernels can sweep across modes with no remainder loop.  The kernel
+// (AVX2/FMA, SSE2 or scalar) is chosen at runtime.
+//
+// Banks of the same size at the same place in each voice of an arena are laid
+// out alike, so the modes of all of them can be advanced in one sweep, as
+// spans of the first bank's arrays (see StringEngine).
+class ModalBank {
+public:
+    // storage must hold getStorageSize(maxModes, numPickups) floats, and
+    // should be cache-aligned
+    ModalBank(int maxModes, int numPickups, float *storage);
+
+    static size_t getStorageSize(int maxModes, int numPickups)
+    {
+        return (size_t) getNumArrays(numPickups) * getPaddedSize(maxModes);
+    }
+
+    static constexpr int maxPickups = 8;
+
+    int getMaxModes() const { return maxModes; }
+    int getNumPickups() const { return buffers.numPickups; }
+    int getNumModes() const { return numModes; }
+    void setNumModes(int newNumModes);
+    // Remove a mode, moving the last mode into its place
+    void removeMode(int i);
+
+    // Reset a mode to the given amplitude, at zero phase
+    void setAmplitude(int i, float amplitude)
+    {
+        buffers.re[i] = amplitude;
+        buffers.im[i] = 0.0f;
+    }
+    float getAmplitude(int i) const
+    {
+        return std::sqrt(buffers.re[i] * buffers.re[i] + buffers.im[i] * buffers.im[i]);
+    }
+    // Set the weight through which an input drives a mode
+    void setDrive(int i, float drive) { buffers.drive[i] = drive; }
+
+    // Set a mode's decay factor per sample, and its phase increment in radians
+    // per sample.  The phase of the mode is preserved.
+    void setCoefficient(int i, float radius, float omega);
+    // Set a mode's complex coefficient r * exp(i * omega) directly
+    void setComplexCoefficient(int i, float coefRe, float coefIm)
+    {
+        buffers.coefRe[i] = coefRe;
+        buffers.coefIm[i] = coefIm;
+    }
+
+    // Set a mode's weight at a pickup immediately
+    void setWeight(int i, int pickup, float newWeight);
+    float getWeight(int i, int pickup) const { return buffers.weight[pickup][i]; }
+    // Set the weights to ramp towards, then ramp all of them linearly over
+    // the next numSamples samples (immediately, if numSamples is zero)
+    void setTargetWeight(int i, int pickup, float target) { weightTarget[pickup][i] = target; }
+    void startWeightRamp(int numSamples);
+    bool isRamping() const { return rampSamplesRemaining > 0; }
+
+    // The first pickup's next sample
+    float getNextSample();
+    // Write the first pickup's next numSamples samples to dest
+    void renderBlock(float *dest, int numSamples);
+    // Add gain times the next numSamples samples to the channels.  Channel c
+    // takes pickup c % numPickups, so a single pickup goes to every channel.
+    // If input is not nullptr, its numSamples samples drive the modes.
+    void addBlock(float *const *dest, int numChannels, int numSamples, float gain,
+                  const float *input = nullptr);
+
+    const char *getKernelName() const { return kernel.name; }
+    // widest SIMD width used by any kernel
+    static constexpr int vectorSize = 8;
+
+    struct Buffers {
+        float *re;
+        float *im;
+        float *coefRe;
+        float *coefIm;
+        float *drive;
+        float *weight[maxPickups];
+        float *weightStep[maxPickups];
+        int numPickups;
+    };
+
+    struct Output {
+        float *const *channels;
+        int numChannels;
+        int offset;
+        float gain;
+        bool accumulate;
+        // if not nullptr, the input driving the modes, indexed as the channels
+        const float *input = nullptr;
+    };
+
+    // The modes [begin, begin + numModes) of a set of arrays, where begin and
+    // numModes are multiples of vectorSize
+    struct Span {
+        int begin;
+        int numModes;
+    };
+
+    // The kernels are specialized on whether the weights ramp, whether an
+    // input drives the modes, and the number of pickups
+    struct Kernel {
+        using Process = void (*)(const Buffers &buffers, const Span *spans, int numSpans, const Output &out,
+                                 int numSamples);
+        Process process[2][2][maxPickups];  // [ramp][driven][numPickups - 1]
+        const char *name;
+
+        Process get(int numPickups, bool ramp, bool driven) const
+        {
+            return process[ramp ? 1 : 0][driven ? 1 : 0][numPickups - 1];
+        }
+    };
+
+    // The state arrays, for renderers that advance the modes themselves
+    const Buffers &getBuffers() const { return buffers; }
+
+    // Sweeping many banks together.  getSpan gives this bank's modes as a
+    // span of base's arrays, and base must be laid out alike.  A bank swept
+    // with ramping weights must be told how far with advanceRamp.
+    Span getSpan(const ModalBank &base) const;
+    int getRampSamplesRemaining() const { return rampSamplesRemaining; }
+    void advanceRamp(int numSamples);
+    static void process(const Buffers &buffers, const Span *spans, int numSpans, const Output &out,
+                        int numSamples, bool ramp);
+
+private:
+    static size_t getPaddedSize(int maxModes) { return VoiceArena::roundUp((size_t) maxModes); }
+    // the phasors, coefficients and drive weights, then the weights, steps
+    // and targets of each pickup
+    static int getNumArrays(int numPickups) { return 5 + 3 * numPickups; }
+
+    void process(Output out, int numSamples);
+    void finishWeightRamp();
+    int getPaddedNumModes() const { return (numModes + vectorSize - 1) / vectorSize * vectorSize; }
+
+    const int maxModes;
+    const int paddedSize;
+    int numModes;
+    const Kernel kernel;
+
+    Buffers buffers;
+    float *weightTarget[maxPickups];
+    int rampSamplesRemaining = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (ModalBank)
+};
@@ -0,0 +1,253 @@
+/*
+  ==============================================================================
+
+    ModalTables.cpp
+    Created: 17 Oct 2026 4:49:33am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#include "ModalTables.h"
+
+bool ModalTables::Table::matches(const StiffString::Parameters &p, double rate, int modes) const
+{
+    return p.stiffness == params.stiffness && p.pluckPos == params.pluckPos
+        && p.decay == params.decay && p.decayHighFreq == params.decayHighFreq
+        && rate == sampleRate && modes == numModes;
+}
+
+const float *const *ModalTables::Table::getPickupShapes(const StiffString::Parameters &p, int pickups, int modes) const
+{
+    if (pickups > numPickups || modes != numModes
+        || !std::equal(p.pickupPos.begin(), p.pickupPos.begin() + pickups, params.pickupPos.begin())) {
+        return nullptr;
+    }
+    return pickupShapeData.data();
+}
+
+ModalTables::ModalTables()
+{
+    cache->add(this);
+}
+
+ModalTables::~ModalTables()
+{
+    cache->remove(this);
+}
+
+void ModalTables::request(const StiffString::Parameters &params, double newSampleRate, int newNumModes,
+                          int newNumPickups)
+{
+    stiffness.store(params.stiffness, std::memory_order_relaxed);
+    pluckPos.store(params.pluckPos, std::memory_order_relaxed);
+    decay.store(params.decay, std::memory_order_relaxed);
+    decayHighFreq.store(params.decayHighFreq, std::memory_order_relaxed);
+    sampleRate.store(newSampleRate, std::memory_order_relaxed);
+    numModes.store(newNumModes, std::memory_order_relaxed);
+    for (size_t p = 0; p < pickupPos.size(); ++p) {
+        pickupPos[p].store(params.pickupPos[p], std::memory_order_relaxed);
+    }
+    numPickups.store(newNumPickups, std::memory_order_relaxed);
+    requested.store(true, std::memory_order_release);
+}
+
+void ModalTables::acquire()
+{
+    current = published.load(std::memory_order_acquire);
+    if (current != nullptr) {
+        acquiredGeneration.store(current->generation, std::memory_order_release);
+    }
+}
+
+void ModalTables::buildIfRequested()
+{
+    if (requested.exchange(false, std::memory_order_acquire)) {
+        build();
+    }
+}
+
+void ModalTables::build()
+{
+    // If another request lands while reading these, the mix is built, and
+    // then the new request is built straight after.
+    auto table = std::make_unique<Table>();
+    table->params.stiffness = stiffness.load(std::memory_order_relaxed);
+    table->params.pluckPos = pluckPos.load(std::memory_order_relaxed);
+    table->params.decay = decay.load(std::memory_order_relaxed);
+    table->params.decayHighFreq = decayHighFreq.load(std::memory_order_relaxed);
+    table->sampleRate = sampleRate.load(std::memory_order_relaxed);
+    table->numModes = numModes.load(std::memory_order_relaxed);
+    for (size_t p = 0; p < pickupPos.size(); ++p) {
+        table->params.pickupPos[p] = pickupPos[p].load(std::memory_order_relaxed);
+    }
+    table->numPickups = juce::jlimit(0, ModalBank::maxPickups, numPickups.load(std::memory_order_relaxed));
+    if (table->sampleRate <= 0.0 || table->numModes <= 0) {
+        return;
+    }
+    if (latest != nullptr && latest->matches(table->params, table->sampleRate, table->numModes)
+        && latest->getPickupShapes(table->params, table->numPickups, table->numModes) != nullptr) {
+        return;
+    }
+
+    // Only the pieces no table in the process holds yet are computed: the
+    // amplitudes depend only on the pluck position, the coefficients not at
+    // all, and each pickup's shape only on its own position.
+    table->amplitudes = cache->getAmplitudes(table->params.pluckPos, table->numModes);
+    table->coefficients = cache->getCoefficients(table->params, table->sampleRate, table->numModes);
+    for (size_t p = 0; p < (size_t) table->numPickups; ++p) {
+        table->pickupShapes[p] = cache->getPickupShape(table->params.pickupPos[p], table->numModes);
+        table->pickupShapeData[p] = table->pickupShapes[p]->values.data();
+    }
+
+    // publish, then free any tables the audio thread has moved on from
+    table->generation = nextGeneration++;
+    if (latest != nullptr) {
+        retired.push_back(std::move(latest));
+    }
+    latest = std::move(table);
+    published.store(latest.get(), std::memory_order_release);
+
+    const uint32_t inUse = acquiredGeneration.load(std::memory_order_acquire);
+    retired.erase(std::remove_if(retired.begin(), retired.end(),
+                                 [inUse](const std::unique_ptr<Table> &t) { return t->generation < inUse; }),
+                  retired.end());
+}
+
+//==============================================================================
+
+ModalTableCache::ModalTableCache() :
+    juce::Thread("Modal table builder")
+{
+    startThread(juce::Thread::Priority::low);
+}
+
+ModalTableCache::~ModalTableCache()
+{
+    stopThread(-1);
+}
+
+void ModalTableCache::add(ModalTables *tables)
+{
+    const juce::ScopedLock sl(lock);
+    instances.push_back(tables);
+}
+
+void ModalTableCache::remove(ModalTables *tables)
+{
+    const juce::ScopedLock sl(lock);
+    instances.erase(std::remove(instances.begin(), instances.end(), tables), instances.end());
+}
+
+void ModalTableCache::run()
+{
+    // Requests may come from the audio thread, which cannot signal, so
+    // poll for them
+    while (!threadShouldExit()) {
+        {
+            const juce::ScopedLock sl(lock);
+            for (auto *tables : instances) {
+                tables->buildIfRequested();
+            }
+        }
+        wait(10);
+    }
+}
+
+template <typename Piece, typename Key>
+std::shared_ptr<const Piece> ModalTableCache::find(std::vector<std::weak_ptr<const Piece>> &pieces, Key key)
+{
+    std::shared_ptr<const Piece> found;
+    for (auto it = pieces.begin(); it != pieces.end(); ) {
+        if (auto piece = it->lock()) {
+            if (found == nullptr && key(*piece)) {
+                found = std::move(piece);
+            }
+            ++it;
+        } else {
+            it = pieces.erase(it);
+        }
+    }
+    return found;
+}
+
+std::shared_ptr<const ModalTables::Amplitudes> ModalTableCache::getAmplitudes(float pluckPos, int numModes)
+{
+    const juce::ScopedLock sl(lock);
+    auto found = find(amplitudes, [&](const ModalTables::Amplitudes &a) {
+        return a.pluckPos == pluckPos && a.numModes == numModes;
+    });
+    if (found != nullptr) {
+        return found;
+    }
+
+    auto piece = std::make_shared<ModalTables::Amplitudes>();
+    piece->pluckPos = pluckPos;
+    piece->numModes = numModes;
+    piece->values.resize((size_t) numModes);
+    const float x0 = pluckPos * 0.5 * PI;
+    for (int i = 0; i < numModes; ++i) {
+        piece->values[(size_t) i] = StiffString::getPluckAmplitude(x0, i + 1);
+    }
+    amplitudes.push_back(piece);
+    return piece;
+}
+
+std::shared_ptr<const ModalTables::Coefficients>
+ModalTableCache::getCoefficients(const StiffString::Parameters &params, double sampleRate, int numModes)
+{
+    const juce::ScopedLock sl(lock);
+    auto found = find(coefficients, [&](const ModalTables::Coefficients &c) {
+        return c.stiffness == params.stiffness && c.decay == params.decay
+            && c.decayHighFreq == params.decayHighFreq && c.sampleRate == sampleRate && c.numModes == numModes;
+    });
+    if (found != nullptr) {
+        return found;
+    }
+
+    auto piece = std::make_shared<ModalTables::Coefficients>();
+    piece->stiffness = params.stiffness;
+    piece->decay = params.decay;
+    piece->decayHighFreq = params.decayHighFreq;
+    piece->sampleRate = sampleRate;
+    piece->numModes = numModes;
+    const size_t size = (size_t) ModalTables::numNotes * (size_t) numModes;
+    piece->re.assign(size, 0.0f);
+    piece->im.assign(size, 0.0f);
+    // as LEAF_setSampleRate works it out for the voices
+    const float twoPiTimesInvSampleRate = (1.0f / (float) sampleRate) * TWO_PI;
+    for (int note = 0; note < ModalTables::numNotes; ++note) {
+        const float freqHz = (float) juce::MidiMessage::getMidiNoteInHertz(note);
+        const float radPerSample = freqHz * twoPiTimesInvSampleRate;
+        float *re = piece->re.data() + (size_t) note * (size_t) numModes;
+        float *im = piece->im.data() + (size_t) note * (size_t) numModes;
+        for (int i = 0; i < numModes; ++i) {
+            float coefRe, coefIm;
+            if (StiffString::getComplexCoefficient(params, i + 1, radPerSample, coefRe, coefIm)) {
+                re[i] = coefRe;
+                im[i] = coefIm;
+            }
+        }
+    }
+    coefficients.push_back(piece);
+    return piece;
+}
+
+std::shared_ptr<const ModalTables::PickupShape> ModalTableCache::getPickupShape(float pickupPos, int numModes)
+{
+    const juce::ScopedLock sl(lock);
+    auto found = find(pickupShapes, [&](const ModalTables::PickupShape &shape) {
+        return shape.pickupPos == pickupPos && shape.numModes == numModes;
+    });
+    if (found != nullptr) {
+        return found;
+    }
+
+    auto piece = std::make_shared<ModalTables::PickupShape>();
+    piece->pickupPos = pickupPos;
+    piece->numModes = numModes;
+    piece->values.resize((size_t) numModes);
+    StiffString::getPickupShape(pickupPos, numModes, piece->values.data());
+    pickupShapes.push_back(piece);
+    return piece;
+}
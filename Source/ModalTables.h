@@ -0,0 +1,172 @@
+/*
+  ==============================================================================
+
+    ModalTables.h
+    Created: 17 Oct 2026 4:49:33am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "StiffString.h"
+
+class ModalTableCache;
+
+// Pluck amplitudes and mode coefficients for every MIDI note, shared by all
+// the voices, so that a note-on is a copy rather than a sin, two sqrts and
+// an exp per mode.  The tables are rebuilt on a background thread whenever
+// the settings they depend on change, and published by swapping a pointer,
+// so the audio thread never waits for them.  Until tables for the current
+// settings are ready, voices compute their modes themselves.
+//
+// The tables also hold the shape of each pickup, for the engine to hand to
+// the voices when the pickups move (see StringEngine::setVoiceParameters).
+//
+// A table is put together from immutable pieces, which are shared with every
+// other table in the process built from the same settings (see
+// ModalTableCache), so that instances of the plugin loaded with the same
+// preset build them once between them.
+class ModalTables {
+public:
+    static constexpr int numNotes = 128;
+
+    // pluck amplitude of each mode number, from 1
+    struct Amplitudes {
+        float pluckPos;
+        int numModes;
+        std::vector<float> values;
+    };
+    // coefficient of each mode, numModes per note; zero above Nyquist
+    struct Coefficients {
+        float stiffness;
+        float decay;
+        float decayHighFreq;
+        double sampleRate;
+        int numModes;
+        std::vector<float> re;
+        std::vector<float> im;
+    };
+    // weight of each mode number, from 1, at a pickup
+    struct PickupShape {
+        float pickupPos;
+        int numModes;
+        std::vector<float> values;
+    };
+
+    struct Table {
+        // only stiffness, pluck position, decay and the pickup positions matter
+        StiffString::Parameters params;
+        double sampleRate = 0.0;
+        int numModes = 0;
+        int numPickups = 0;
+
+        std::shared_ptr<const Amplitudes> amplitudes;
+        std::shared_ptr<const Coefficients> coefficients;
+        std::array<std::shared_ptr<const PickupShape>, ModalBank::maxPickups> pickupShapes;
+        std::array<const float *, ModalBank::maxPickups> pickupShapeData {};
+
+        // whether the amplitudes and coefficients are for these settings
+        bool matches(const StiffString::Parameters &p, double rate, int modes) const;
+        // The shapes of the first numPickups pickups, as
+        // StiffString::setParameters takes them, if these tables have them
+        // for the given settings, or else nullptr
+        const float *const *getPickupShapes(const StiffString::Parameters &p, int pickups, int modes) const;
+        const float *getAmplitudes() const { return amplitudes->values.data(); }
+        const float *getCoefRe(int note) const { return coefficients->re.data() + (size_t) note * (size_t) numModes; }
+        const float *getCoefIm(int note) const { return coefficients->im.data() + (size_t) note * (size_t) numModes; }
+
+        uint32_t generation = 0;
+    };
+
+    ModalTables();
+    ~ModalTables();
+
+    // Ask for tables for these settings.  Lock-free, so it may be called
+    // from the audio thread; the builder picks the request up shortly after.
+    void request(const StiffString::Parameters &params, double sampleRate, int numModes, int numPickups);
+
+    // Audio thread, once per block: take the newest published tables, which
+    // stay valid until the next call.  Tables the audio thread has moved on
+    // from are freed by the builder.
+    void acquire();
+    // The tables taken by the last acquire(), or nullptr
+    const Table *getCurrent() const { return current; }
+
+    // The process-wide cache the tables are built from
+    ModalTableCache &getCache() { return *cache; }
+
+private:
+    friend class ModalTableCache;
+
+    // on the cache's builder thread, if there is a new request
+    void buildIfRequested();
+    void build();
+
+    // the latest request
+    std::atomic<float> stiffness { 0.0f };
+    std::atomic<float> pluckPos { 0.0f };
+    std::atomic<float> decay { 0.0f };
+    std::atomic<float> decayHighFreq { 0.0f };
+    std::atomic<double> sampleRate { 0.0 };
+    std::atomic<int> numModes { 0 };
+    std::array<std::atomic<float>, ModalBank::maxPickups> pickupPos {};
+    std::atomic<int> numPickups { 0 };
+    std::atomic<bool> requested { false };
+
+    // held first, so that it outlives the tables built from its pieces
+    juce::SharedResourcePointer<ModalTableCache> cache;
+
+    // owned by the builder
+    std::unique_ptr<Table> latest;
+    std::vector<std::unique_ptr<Table>> retired;
+    uint32_t nextGeneration = 1;
+
+    std::atomic<const Table *> published { nullptr };
+    // generation of the tables the audio thread last took
+    std::atomic<uint32_t> acquiredGeneration { 0 };
+    const Table *current = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE (ModalTables)
+};
+
+// What the ModalTables of every plugin instance in the process share: one
+// builder thread, and the pieces of the tables built so far.  A piece lives
+// as long as some table holds it, and any table wanting the same settings
+// in the meantime gets the same piece.  Held through a
+// juce::SharedResourcePointer, so it is created with the first instance and
+// goes with the last.
+class ModalTableCache : private juce::Thread {
+public:
+    ModalTableCache();
+    ~ModalTableCache() override;
+
+    // The pieces for the given settings, built now if no table holds them.
+    // These lock and may allocate, so never call them from the audio thread.
+    std::shared_ptr<const ModalTables::Amplitudes> getAmplitudes(float pluckPos, int numModes);
+    std::shared_ptr<const ModalTables::Coefficients> getCoefficients(const StiffString::Parameters &params,
+                                                                     double sampleRate, int numModes);
+    std::shared_ptr<const ModalTables::PickupShape> getPickupShape(float pickupPos, int numModes);
+
+    void add(ModalTables *tables);
+    void remove(ModalTables *tables);
+
+private:
+    void run() override;
+
+    // Find a live piece matching key, forgetting any that have been freed
+    template <typename Piece, typename Key>
+    static std::shared_ptr<const Piece> find(std::vector<std::weak_ptr<const Piece>> &pieces, Key key);
+
+    // guards everything below, and is held while building, so that a
+    // ModalTables is never removed halfway through a build
+    juce::CriticalSection lock;
+    std::vector<ModalTables *> instances;
+    std::vector<std::weak_ptr<const ModalTables::Amplitudes>> amplitudes;
+    std::vector<std::weak_ptr<const ModalTables::Coefficients>> coefficients;
+    std::vector<std::weak_ptr<const ModalTables::PickupShape>> pickupShapes;
+
+    JUCE_DECLARE_NON_COPYABLE (ModalTableCache)
+};
@@ -0,0 +1,498 @@
+/*
+  ==============================================================================
+
+    MultirateRenderer.cpp
+    Created: 17 Oct 2026 6:08:49am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#include "MultirateRenderer.h"
+
+namespace {
+// Kaiser window parameter of the halfband filters
+constexpr double kaiserBeta = 10.0;
+// a mode is only run backwards at a pluck if that scales it up by less than
+// this, or it would swamp the float precision of the modes it is summed with
+constexpr double maxBackwardGrowth = 100.0;
+// The kernels advance up to four vectors of modes at a time, each waiting on
+// its own last sample, and with AVX2 a group costs about the same however
+// few modes it has.  Costs are counted in groups advanced one sample.
+constexpr int modesPerGroup = 4 * ModalBank::vectorSize;
+// the cost of an interpolator stage per input sample and pickup
+constexpr float stageCost = 0.25f;
+// bands are used if they cost no more than this fraction of the full rate
+constexpr float worthwhileCostRatio = 0.7f;
+
+int roundUpToVector(int numModes)
+{
+    return (numModes + ModalBank::vectorSize - 1) / ModalBank::vectorSize * ModalBank::vectorSize;
+}
+}
+
+MultirateRenderer::MultirateRenderer(int maxModes, int numPickups, float *storage) :
+    evenTaps(getEvenTaps()),
+    numPickups(numPickups),
+    paddedSize((int) VoiceArena::roundUp((size_t) maxModes)),
+    modeBands(VoiceArena::createInts(storage + (size_t) numBands * (5 + 2 * numPickups) * paddedSize,
+                                     2 * (size_t) paddedSize)),
+    modeSlots(modeBands + paddedSize)
+{
+    jassert(numPickups >= 1 && numPickups <= ModalBank::maxPickups);
+    float *next = storage;
+    for (int b = 0; b < numBands; ++b) {
+        auto &band = bands[b];
+        band = {};
+        band.numPickups = numPickups;
+        band.re = next;
+        band.im = band.re + paddedSize;
+        band.coefRe = band.im + paddedSize;
+        band.coefIm = band.coefRe + paddedSize;
+        next = band.coefIm + paddedSize;
+        for (int p = 0; p < numPickups; ++p) {
+            band.weight[p] = next;
+            band.weightStep[p] = next + paddedSize;
+            next += 2 * paddedSize;
+        }
+        std::fill(band.re, next, 0.0f);
+        bandModes[b] = VoiceArena::createInts(next, (size_t) paddedSize);
+        next += paddedSize;
+
+        const double pi = juce::MathConstants<double>::pi;
+        assignCos[b] = (float) std::cos(0.5 * pi / (1 << b));
+        keepCos[b] = (float) std::cos(0.6 * pi / (1 << b));
+    }
+    next += 2 * paddedSize;  // modeBands and modeSlots
+    for (int k = 0; k < maxStages; ++k) {
+        const size_t size = VoiceArena::roundUp((size_t) (historySize + (maxBatchSize >> (k + 1))));
+        for (int p = 0; p < numPickups; ++p) {
+            std::fill(next, next + size, 0.0f);
+            stageInput[k][p] = next + historySize;
+            next += size;
+        }
+    }
+    for (int p = 0; p < numPickups; ++p) {
+        output[p] = next;
+        next += VoiceArena::roundUp(maxBatchSize);
+    }
+}
+
+size_t MultirateRenderer::getStorageSize(int maxModes, int numPickups)
+{
+    // each band's arrays and mode indices, the band and slot of each mode,
+    // then the stage inputs and output of each pickup
+    const size_t padded = VoiceArena::roundUp((size_t) maxModes);
+    size_t stages = 0;
+    for (int k = 0; k < maxStages; ++k) {
+        stages += VoiceArena::roundUp((size_t) (historySize + (maxBatchSize >> (k + 1))));
+    }
+    return (size_t) numBands * (size_t) (5 + 2 * numPickups) * padded + 2 * padded
+         + (size_t) numPickups * (stages + VoiceArena::roundUp(maxBatchSize));
+}
+
+const float *MultirateRenderer::getEvenTaps()
+{
+    // The even taps h[2i] of the halfband lowpass, times two for the gain of
+    // doubling the rate, and scaled so that they sum to one, as the odd
+    // phase (the centre tap alone) does
+    static const std::vector<float> taps = [] {
+        const auto besselI0 = [](double x) {
+            double sum = 1.0, term = 1.0;
+            for (int k = 1; k < 50; ++k) {
+                term *= (x / (2 * k)) * (x / (2 * k));
+                sum += term;
+            }
+            return sum;
+        };
+        const int centre = 2 * halfbandOrder - 1;
+        std::vector<double> h((size_t) numEvenTaps);
+        double sum = 0.0;
+        for (int i = 0; i < numEvenTaps; ++i) {
+            const double offset = 2 * i - centre;
+            const double x = juce::MathConstants<double>::pi * offset / 2;
+            const double ratio = offset / centre;
+            const double window = besselI0(kaiserBeta * std::sqrt(1.0 - ratio * ratio)) / besselI0(kaiserBeta);
+            h[(size_t) i] = std::sin(x) / x * window;
+            sum += h[(size_t) i];
+        }
+        std::vector<float> t((size_t) numEvenTaps);
+        for (int i = 0; i < numEvenTaps; ++i) {
+            t[(size_t) i] = (float) (h[(size_t) i] / sum);
+        }
+        return t;
+    }();
+    return taps.data();
+}
+
+int MultirateRenderer::chooseBand(const ModalBank &bank, int i) const
+{
+    const auto &b = bank.getBuffers();
+    const float magnitude = std::sqrt(b.coefRe[i] * b.coefRe[i] + b.coefIm[i] * b.coefIm[i]);
+    for (int band = maxStages; band > 0; --band) {
+        if (b.coefRe[i] >= magnitude * assignCos[band]) {
+            return band;
+        }
+    }
+    return 0;
+}
+
+float MultirateRenderer::planBands(const ModalBank &bank, int *map) const
+{
+    // A band with a few modes costs nearly as much as a full group, so try
+    // every set of bands, each mode going to the lowest band of the set that
+    // it fits, and keep the cheapest
+    int counts[numBands] = {};
+    for (int i = 0; i < bank.getNumModes(); ++i) {
+        ++counts[chooseBand(bank, i)];
+    }
+    float bestCost = std::numeric_limits<float>::max();
+    for (int set = 1; set < (1 << numBands); set += 2) {
+        int candidate[numBands];
+        int sizes[numBands] = {};
+        int lowest = 0;
+        for (int band = 0, used = 0; band < numBands; ++band) {
+            used = (set >> band) & 1 ? band : used;
+            candidate[band] = used;
+            sizes[used] += counts[band];
+        }
+        float cost = 0.0f;
+        for (int band = 0; band < numBands; ++band) {
+            const int groups = (sizes[band] + modesPerGroup - 1) / modesPerGroup;
+            cost += (float) groups / (float) (1 << band);
+            lowest = sizes[band] > 0 ? band : lowest;
+        }
+        // stage k runs at 1 / 2^k of the sample rate
+        cost += stageCost * (float) numPickups * (1.0f - 1.0f / (float) (1 << lowest));
+        if (cost < bestCost) {
+            bestCost = cost;
+            std::copy(candidate, candidate + numBands, map);
+        }
+    }
+    return bestCost;
+}
+
+bool MultirateRenderer::isWorthUsing(const ModalBank &bank) const
+{
+    int map[numBands];
+    const int groups = (bank.getNumModes() + modesPerGroup - 1) / modesPerGroup;
+    return planBands(bank, map) < worthwhileCostRatio * (float) groups;
+}
+
+int MultirateRenderer::getWarmUpLength() const
+{
+    // stage k forgets in historySize of its inputs, 2^k samples apart, and
+    // each stage's input is only right once the stage below has forgotten
+    const int frameSize = 1 << numStages;
+    const int length = historySize * ((2 << numStages) - 2);
+    return (length + frameSize - 1) / frameSize * frameSize;
+}
+
+void MultirateRenderer::start(const ModalBank &bank)
+{
+    for (int band = 0; band < numBands; ++band) {
+        const int size = roundUpToVector(bandSizes[band]);
+        auto &b = bands[band];
+        for (float *a : { b.re, b.im, b.coefRe, b.coefIm }) {
+            std::fill(a, a + size, 0.0f);
+        }
+        for (int p = 0; p < numPickups; ++p) {
+            std::fill(b.weight[p], b.weight[p] + size, 0.0f);
+            std::fill(b.weightStep[p], b.weightStep[p] + size, 0.0f);
+        }
+        bandSizes[band] = 0;
+    }
+
+    planBands(bank, bandMap);
+    numTracked = bank.getNumModes();
+    numStages = 0;
+    for (int i = 0; i < numTracked; ++i) {
+        modeBands[i] = bandMap[chooseBand(bank, i)];
+        numStages = juce::jmax(numStages, modeBands[i]);
+    }
+
+    // Start each low band's modes far enough back that the interpolators
+    // have forgotten the silence by the time the output starts, and that
+    // far plus the band's delay ahead of the output
+    const int warmUp = getWarmUpLength();
+    const auto &b = bank.getBuffers();
+    const double maxDecay = std::log(maxBackwardGrowth) / juce::jmax(1, warmUp);
+    for (int i = 0; i < numTracked; ++i) {
+        int band = modeBands[i];
+        const double magnitude = std::sqrt((double) b.coefRe[i] * b.coefRe[i] + (double) b.coefIm[i] * b.coefIm[i]);
+        if (band > 0 && -std::log(magnitude) > maxDecay) {
+            band = 0;
+        }
+        addMode(bank, i, band, band > 0 ? getDelay(band) - warmUp : 0);
+    }
+
+    for (int k = 0; k < numStages; ++k) {
+        for (int p = 0; p < numPickups; ++p) {
+            std::fill(stageInput[k][p] - historySize, stageInput[k][p], 0.0f);
+        }
+    }
+    gatherWeights(bank);
+    const int frameSize = 1 << numStages;
+    for (int frames = warmUp / frameSize; frames > 0; frames -= maxFramesPerBatch) {
+        renderFrames(juce::jmin(frames, maxFramesPerBatch), 0);
+    }
+    outputPosition = outputSize = 0;
+    needsRestart = false;
+    needsCoefficients = false;
+    needsWeights = false;
+}
+
+void MultirateRenderer::updateCoefficients(const ModalBank &bank)
+{
+    // The bank's phasors are where the bands left them, so a mode taken
+    // past its band's passband moves to the band it now fits, from there
+    const auto &b = bank.getBuffers();
+    for (int i = 0; i < bank.getNumModes(); ++i) {
+        const int band = i < numTracked ? modeBands[i] : -1;
+        if (band < 0) {
+            addMode(bank, i, bandMap[chooseBand(bank, i)], 0);
+            continue;
+        }
+        const float magnitude = std::sqrt(b.coefRe[i] * b.coefRe[i] + b.coefIm[i] * b.coefIm[i]);
+        if (band > 0 && b.coefRe[i] < magnitude * keepCos[band]) {
+            detachMode(i);
+            addMode(bank, i, bandMap[juce::jmin(chooseBand(bank, i), band - 1)], 0);
+        } else {
+            setBandCoefficient(bank, i);
+        }
+    }
+    numTracked = bank.getNumModes();
+    needsCoefficients = false;
+    // modes added or moved need their weights
+    needsWeights = true;
+}
+
+void MultirateRenderer::addMode(const ModalBank &bank, int i, int band, int advance)
+{
+    const auto &b = bank.getBuffers();
+    auto &dest = bands[band];
+    const int slot = bandSizes[band]++;
+    bandModes[band][slot] = i;
+    modeBands[i] = band;
+    modeSlots[i] = slot;
+
+    double re = b.re[i];
+    double im = b.im[i];
+    if (advance != 0) {
+        // times c^advance
+        const double magnitude = std::sqrt((double) b.coefRe[i] * b.coefRe[i] + (double) b.coefIm[i] * b.coefIm[i]);
+        const double angle = std::atan2((double) b.coefIm[i], (double) b.coefRe[i]) * advance;
+        const double scale = std::pow(magnitude, (double) advance);
+        const double cRe = scale * std::cos(angle);
+        const double cIm = scale * std::sin(angle);
+        const double newRe = re * cRe - im * cIm;
+        im = re * cIm + im * cRe;
+        re = newRe;
+    }
+    dest.re[slot] = (float) re;
+    dest.im[slot] = (float) im;
+    setBandCoefficient(bank, i);
+}
+
+void MultirateRenderer::setBandCoefficient(const ModalBank &bank, int i)
+{
+    // c^(2^band), by squaring in double precision
+    const auto &b = bank.getBuffers();
+    const int band = modeBands[i];
+    double re = b.coefRe[i];
+    double im = b.coefIm[i];
+    for (int k = 0; k < band; ++k) {
+        const double newRe = re * re - im * im;
+        im = 2.0 * re * im;
+        re = newRe;
+    }
+    bands[band].coefRe[modeSlots[i]] = (float) re;
+    bands[band].coefIm[modeSlots[i]] = (float) im;
+}
+
+void MultirateRenderer::detachMode(int i)
+{
+    // move the band's last mode into the slot, and silence the last slot
+    const int band = modeBands[i];
+    const int slot = modeSlots[i];
+    const int last = --bandSizes[band];
+    auto &b = bands[band];
+    const auto move = [slot, last](float *a) {
+        a[slot] = a[last];
+        a[last] = 0.0f;
+    };
+    for (float *a : { b.re, b.im, b.coefRe, b.coefIm }) {
+        move(a);
+    }
+    for (int p = 0; p < numPickups; ++p) {
+        move(b.weight[p]);
+        move(b.weightStep[p]);
+    }
+    bandModes[band][slot] = bandModes[band][last];
+    modeSlots[bandModes[band][slot]] = slot;
+    modeBands[i] = -1;
+}
+
+void MultirateRenderer::removeMode(int i, int last)
+{
+    if (needsRestart || i >= numTracked) {
+        return;
+    }
+    if (modeBands[i] >= 0) {
+        detachMode(i);
+    }
+    if (last != i) {
+        // the bank's last mode takes index i
+        modeBands[i] = last < numTracked ? modeBands[last] : -1;
+        modeSlots[i] = last < numTracked ? modeSlots[last] : 0;
+        if (modeBands[i] >= 0) {
+            bandModes[modeBands[i]][modeSlots[i]] = i;
+        }
+    }
+    numTracked = juce::jmin(numTracked, last);
+}
+
+void MultirateRenderer::gatherWeights(const ModalBank &bank)
+{
+    // Each band ramps its weights on from here by itself, 2^band times as
+    // far per step in band b
+    const auto &b = bank.getBuffers();
+    const bool ramping = bank.isRamping();
+    for (int band = 0; band < numBands; ++band) {
+        auto &dest = bands[band];
+        const float stepScale = (float) (1 << band);
+        for (int p = 0; p < numPickups; ++p) {
+            for (int slot = 0; slot < bandSizes[band]; ++slot) {
+                const int i = bandModes[band][slot];
+                dest.weight[p][slot] = b.weight[p][i];
+                dest.weightStep[p][slot] = ramping ? b.weightStep[p][i] * stepScale : 0.0f;
+            }
+        }
+    }
+}
+
+void MultirateRenderer::scatterPhasors(const ModalBank &bank) const
+{
+    const auto &b = bank.getBuffers();
+    for (int band = 0; band < numBands; ++band) {
+        for (int slot = 0; slot < bandSizes[band]; ++slot) {
+            const int i = bandModes[band][slot];
+            b.re[i] = bands[band].re[slot];
+            b.im[i] = bands[band].im[slot];
+        }
+    }
+}
+
+void MultirateRenderer::renderFrames(int numFrames, int rampSamples)
+{
+    // From the lowest band up: each band is added to the stage below's
+    // output, at the band's rate, and the sum doubled in rate for the next
+    const int numSamples = numFrames << numStages;
+    for (int k = numStages; k > 0; --k) {
+        const int numTicks = numSamples >> k;
+        if (k == numStages) {
+            for (int p = 0; p < numPickups; ++p) {
+                std::fill(stageInput[k - 1][p], stageInput[k - 1][p] + numTicks, 0.0f);
+            }
+        }
+        if (bandSizes[k] > 0) {
+            const ModalBank::Span span { 0, roundUpToVector(bandSizes[k]) };
+            const int rampTicks = juce::jmin(numTicks, (rampSamples + (1 << k) - 1) >> k);
+            if (rampTicks > 0) {
+                ModalBank::process(bands[k], &span, 1, { stageInput[k - 1], numPickups, 0, 1.0f, true },
+                                   rampTicks, true);
+            }
+            if (numTicks > rampTicks) {
+                ModalBank::process(bands[k], &span, 1, { stageInput[k - 1], numPickups, rampTicks, 1.0f, true },
+                                   numTicks - rampTicks, false);
+            }
+        }
+        interpolate(k, numTicks);
+    }
+}
+
+void MultirateRenderer::interpolate(int stage, int numInput)
+{
+    // y[2j] = sum of evenTaps[i] x[j - i], whose taps are symmetric, and
+    // y[2j + 1] = x[j - halfbandOrder + 1], the centre tap
+    for (int p = 0; p < numPickups; ++p) {
+        float *x = stageInput[stage - 1][p];
+        float *y = stage > 1 ? stageInput[stage - 2][p] : output[p];
+        for (int j = 0; j < numInput; ++j) {
+            float sum = 0.0f;
+            for (int i = 0; i < halfbandOrder; ++i) {
+                sum += evenTaps[i] * (x[j - i] + x[j - historySize + i]);
+            }
+            y[2 * j] = sum;
+            y[2 * j + 1] = x[j - halfbandOrder + 1];
+        }
+        std::copy(x + numInput - historySize, x + numInput, x - historySize);
+    }
+}
+
+void MultirateRenderer::process(ModalBank &bank, float *const *channels, int numChannels, int numSamples,
+                                float gain, bool accumulate)
+{
+    if (needsRestart) {
+        start(bank);
+    } else if (needsCoefficients) {
+        updateCoefficients(bank);
+    }
+    if (needsWeights) {
+        gatherWeights(bank);
+        needsWeights = false;
+    }
+    const int rampSamples = bank.getRampSamplesRemaining();
+
+    if (!accumulate) {
+        for (int ch = 0; ch < numChannels; ++ch) {
+            juce::FloatVectorOperations::clear(channels[ch], numSamples);
+        }
+    }
+
+    // band 0, straight into the output
+    const int rampLength = juce::jmin(numSamples, rampSamples);
+    if (bandSizes[0] > 0) {
+        const ModalBank::Span span { 0, roundUpToVector(bandSizes[0]) };
+        if (rampLength > 0) {
+            ModalBank::process(bands[0], &span, 1, { channels, numChannels, 0, gain, true }, rampLength, true);
+        }
+        if (numSamples > rampLength) {
+            ModalBank::process(bands[0], &span, 1, { channels, numChannels, rampLength, gain, true },
+                               numSamples - rampLength, false);
+        }
+    }
+
+    // the low bands, through the interpolators
+    const int frameSize = 1 << numStages;
+    for (int done = 0; numStages > 0 && done < numSamples; ) {
+        if (outputPosition == outputSize) {
+            const int numFrames = juce::jmin(maxFramesPerBatch, (numSamples - done + frameSize - 1) / frameSize);
+            renderFrames(numFrames, juce::jmax(0, rampSamples - done));
+            outputPosition = 0;
+            outputSize = numFrames * frameSize;
+        }
+        const int n = juce::jmin(outputSize - outputPosition, numSamples - done);
+        for (int ch = 0; ch < numChannels; ++ch) {
+            juce::FloatVectorOperations::addWithMultiply(channels[ch] + done, output[ch % numPickups] + outputPosition,
+                                                         gain, n);
+        }
+        outputPosition += n;
+        done += n;
+    }
+
+    scatterPhasors(bank);
+    // the bank's weights, which its kernels would have ramped
+    if (rampLength > 0) {
+        const auto &b = bank.getBuffers();
+        for (int p = 0; p < numPickups; ++p) {
+            for (int i = 0; i < bank.getNumModes(); ++i) {
+                b.weight[p][i] += b.weightStep[p][i] * (float) rampLength;
+            }
+        }
+        bank.advanceRamp(rampLength);
+        // the low bands' ramps end on a tick, so take the final weights
+        // exactly when the bank's ends
+        needsWeights = !bank.isRamping();
+    }
+}
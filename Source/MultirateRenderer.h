@@ -0,0 +1,159 @@
+/*
+  ==============================================================================
+
+    MultirateRenderer.h
+    Created: 17 Oct 2026 6:08:49am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ModalBank.h"
+
+// Renders the modes of a ModalBank in octave bands, each at the lowest rate
+// its modes allow.  Band b runs at 1 / 2^b of the sample rate, advancing its
+// modes once per 2^b samples by the coefficient c^(2^b), so a low mode costs
+// a fraction of a multiply per sample.  The bands are brought back up to the
+// sample rate by a cascade of halfband interpolators: the lowest band is
+// doubled in rate and added to the next, which is doubled and added to the
+// next, and so on, so the cascade costs about two interpolator stages per
+// output sample however many bands there are.
+//
+// A mode fits a band if its frequency is below half the band's Nyquist
+// frequency, leaving headroom for pitch bends, and it only moves up a band
+// if a change of coefficients takes it past the interpolators' passband.
+// Modes are advanced in groups that cost about the same however few modes
+// they hold, so at a pluck the bands to use are chosen by their cost, and a
+// band with few modes may be left out, its modes going to the next band up.
+// Band 0, at the full rate, takes the modes above an eighth of the sample
+// rate, and any mode damped so fast that running it backwards (below) would
+// lose precision.
+//
+// The interpolators delay each band by a whole number of samples, so each
+// band's modes run that far ahead of the output, and the delay costs no
+// latency.  At a pluck, every band is started from its modes run backwards
+// for as long as the interpolators remember, so the interpolators hold the
+// modes' past rather than silence, and the output is exact from the first
+// sample.  Weight ramps and coefficient changes reach each band as its modes
+// are advanced, so they are heard up to that band's delay late, a few
+// milliseconds at most.
+//
+// While the renderer is in use, the bank's phasors are written back after
+// each block for the bank's amplitude checks, and the bank's own kernels are
+// not used.  The modes of each band are kept in arrays of their own, laid
+// out as a ModalBank's, and advanced by its kernels.
+class MultirateRenderer {
+public:
+    // storage must hold getStorageSize(maxModes, numPickups) floats
+    MultirateRenderer(int maxModes, int numPickups, float *storage);
+
+    static size_t getStorageSize(int maxModes, int numPickups);
+
+    // Whether rendering the bank's modes in bands would save enough to be
+    // worth it
+    bool isWorthUsing(const ModalBank &bank) const;
+
+    // The bank's phasors were reset (a pluck): start again from them at the
+    // next sample rendered
+    void restart() { needsRestart = true; }
+    // The bank's coefficients changed, or it gained modes at the end: pick
+    // them up at the next sample rendered
+    void coefficientsChanged() { needsCoefficients = true; }
+    // The bank's weights were set, or started a ramp
+    void weightsChanged() { needsWeights = true; }
+    // Mirror ModalBank::removeMode, for the mode about to be removed
+    void removeMode(int i, int last);
+
+    // Write (or add, if accumulate) gain times the next numSamples samples of
+    // the bank to each of the channels, channel c taking pickup c % numPickups,
+    // and advance the bank's weight ramp
+    void process(ModalBank &bank, float *const *channels, int numChannels, int numSamples,
+                 float gain, bool accumulate);
+
+    // band b runs at 1 / 2^b of the sample rate
+    static constexpr int numBands = 5;
+    static constexpr int maxStages = numBands - 1;
+
+private:
+    void start(const ModalBank &bank);
+    void updateCoefficients(const ModalBank &bank);
+    // the lowest band mode i of the bank fits in, with headroom
+    int chooseBand(const ModalBank &bank, int i) const;
+    // Choose the bands to use for the bank's modes: map[b] is the band for
+    // the modes that fit band b.  Returns the cost per sample.
+    float planBands(const ModalBank &bank, int *map) const;
+    // Add mode i of the bank to a band, advanced by the given number of
+    // samples (which may be negative)
+    void addMode(const ModalBank &bank, int i, int band, int advance);
+    void setBandCoefficient(const ModalBank &bank, int i);
+    void detachMode(int i);
+    void gatherWeights(const ModalBank &bank);
+    // Write the bands' phasors back to the bank
+    void scatterPhasors(const ModalBank &bank) const;
+    // Render numFrames frames of the low bands into the output buffers, with
+    // the weights ramping for the first rampSamples samples
+    void renderFrames(int numFrames, int rampSamples);
+    // Double the rate of numInput samples of a stage's input, into the next
+    // stage's input or the output buffers
+    void interpolate(int stage, int numInput);
+    // long enough for every stage to forget the silence before a pluck
+    int getWarmUpLength() const;
+
+    // the delay of band b through the interpolators, in samples
+    static int getDelay(int band) { return stageDelay * ((1 << band) - 1); }
+
+    // Each interpolator stage is a halfband lowpass of 4 * halfbandOrder - 1
+    // taps, Kaiser windowed.  Every other tap is zero but the centre, so the
+    // even outputs need 2 * halfbandOrder taps, and the odd outputs are a
+    // copy of the input.  The passband reaches 0.6 of the input's Nyquist
+    // frequency, and the images of the passband are below -95 dB.
+    static constexpr int halfbandOrder = 9;
+    static constexpr int numEvenTaps = 2 * halfbandOrder;
+    static constexpr int historySize = numEvenTaps - 1;
+    static constexpr int stageDelay = 2 * halfbandOrder - 1;
+    static const float *getEvenTaps();
+
+    // The low bands are rendered in frames of 2^numStages samples, one tick of
+    // the lowest band, a batch of up to maxFramesPerBatch at a time
+    static constexpr int maxFramesPerBatch = 16;
+    static constexpr int maxFrameSize = 1 << maxStages;
+    static constexpr int maxBatchSize = maxFramesPerBatch * maxFrameSize;
+
+    const float *const evenTaps;
+    const int numPickups;
+    const int paddedSize;
+    // per band, the cosine of the highest frequency a mode is put in the
+    // band at, and of the highest it can stay at
+    float assignCos[numBands];
+    float keepCos[numBands];
+
+    // the band used for the modes that fit each band
+    int bandMap[numBands] = {};
+    // each band's modes, laid out as a ModalBank's, and the bank index of each
+    ModalBank::Buffers bands[numBands];
+    int *bandModes[numBands];
+    int bandSizes[numBands] = {};
+    // the band of each of the first numTracked of the bank's modes (-1 for
+    // one not picked up yet), and its place in the band
+    int *const modeBands;
+    int *const modeSlots;
+    int numTracked = 0;
+
+    // For each pickup, the input of stage k (from 1) at stageInput[k - 1],
+    // after the history it keeps, and the output of the first stage, played
+    // from outputPosition
+    float *stageInput[maxStages][ModalBank::maxPickups];
+    float *output[ModalBank::maxPickups];
+    int numStages = 0;
+    int outputPosition = 0;
+    int outputSize = 0;
+
+    bool needsRestart = false;
+    bool needsCoefficients = false;
+    bool needsWeights = false;
+
+    JUCE_DECLARE_NON_COPYABLE (MultirateRenderer)
+};
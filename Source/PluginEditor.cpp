@@ -9,17 +9,79 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+//==============================================================================
+void LoadGraph::addBlock(float load)
+{
+    history[(size_t) writeIndex] = load;
+    writeIndex = (writeIndex + 1) % historySize;
+}
+
+void LoadGraph::paint(juce::Graphics &g)
+{
+    auto bounds = getLocalBounds().toFloat();
+    g.setColour(juce::Colours::black);
+    g.fillRect(bounds);
+
+    // the deadline
+    const float deadlineY = bounds.getBottom() - bounds.getHeight() / maxLoad;
+    g.setColour(juce::Colours::red.withAlpha(0.6f));
+    g.drawHorizontalLine((int) deadlineY, bounds.getX(), bounds.getRight());
+
+    const float dx = bounds.getWidth() / (float) historySize;
+    for (int i = 0; i < historySize; ++i) {
+        const float load = history[(size_t) ((writeIndex + i) % historySize)];
+        const float height = juce::jmin(load / maxLoad, 1.0f) * bounds.getHeight();
+        g.setColour(load > 1.0f ? juce::Colours::red : juce::Colours::limegreen);
+        g.fillRect(bounds.getX() + i * dx, bounds.getBottom() - height, juce::jmax(dx, 1.0f), height);
+    }
+
+    g.setColour(juce::Colours::grey);
+    g.drawRect(bounds);
+}
+
 //==============================================================================
 StiffStringAudioProcessorEditor::StiffStringAudioProcessorEditor (StiffStringAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p), stats (LoadMonitor::capacity)
 {
+    auto &params = audioProcessor.getParams();
+    // a slider for the position of each pickup in use
+    const int numPickups = juce::jmax(1, audioProcessor.getNumPickups());
+    juce::StringArray ids { "STIFFNESS", "PLUCKPOS" };
+    for (int pickup = 0; pickup < numPickups; ++pickup) {
+        ids.add(StiffStringAudioProcessor::getPickupPosID(pickup));
+    }
+    ids.addArray({ "DECAY", "DECAYHF", "RESONANCE", "PLUCK", "DRIVE", "VOICES", "MODES" });
+    for (const auto &id : ids) {
+        auto *label = parameterLabels.add(new juce::Label({}, params.getParameter(id)->getName(32)));
+        addAndMakeVisible(label);
+        auto *slider = parameterSliders.add(new juce::Slider(juce::Slider::LinearHorizontal, juce::Slider::TextBoxRight));
+        addAndMakeVisible(slider);
+        sliderAttachments.add(new juce::AudioProcessorValueTreeState::SliderAttachment(params, id, *slider));
+    }
+    parallelButton.setButtonText(params.getParameter("PARALLEL")->getName(32));
+    addAndMakeVisible(parallelButton);
+    parallelAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(params, "PARALLEL", parallelButton);
+    governorButton.setButtonText(params.getParameter("GOVERNOR")->getName(32));
+    addAndMakeVisible(governorButton);
+    governorAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(params, "GOVERNOR", governorButton);
+
+    addAndMakeVisible(loadGraph);
+    addAndMakeVisible(countersLabel);
+    countersLabel.setJustificationType(juce::Justification::topLeft);
+    addAndMakeVisible(logButton);
+    logButton.onClick = [this] { setLogging(logButton.getToggleState()); };
+    addAndMakeVisible(resetButton);
+    resetButton.onClick = [this] { peakLoad = 0.0f; };
+
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (400, 300);
+    setSize (500, 564 + 28 * (numPickups - 1));
+    startTimerHz(30);
 }
 
 StiffStringAudioProcessorEditor::~StiffStringAudioProcessorEditor()
 {
+    stopTimer();
 }
 
 //==============================================================================
@@ -27,14 +89,82 @@ void StiffStringAudioProcessorEditor::paint (juce::Graphics& g)
 {
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
-
-    g.setColour (juce::Colours::white);
-    g.setFont (15.0f);
-    g.drawFittedText ("Hello World!", getLocalBounds(), juce::Justification::centred, 1);
 }
 
 void StiffStringAudioProcessorEditor::resized()
 {
-    // This is generally where you'll want to lay out the positions of any
-    // subcomponents in your editor..
+    auto area = getLocalBounds().reduced(10);
+    for (int i = 0; i < parameterSliders.size(); ++i) {
+        auto row = area.removeFromTop(28);
+        parameterLabels[i]->setBounds(row.removeFromLeft(100));
+        parameterSliders[i]->setBounds(row);
+    }
+    auto toggles = area.removeFromTop(28).withTrimmedLeft(100);
+    parallelButton.setBounds(toggles.removeFromLeft(toggles.getWidth() / 2));
+    governorButton.setBounds(toggles);
+
+    area.removeFromTop(10);
+    auto buttons = area.removeFromBottom(28);
+    logButton.setBounds(buttons.removeFromLeft(160));
+    resetButton.setBounds(buttons.removeFromRight(100));
+    countersLabel.setBounds(area.removeFromBottom(44));
+    loadGraph.setBounds(area.reduced(0, 4));
+}
+
+void StiffStringAudioProcessorEditor::timerCallback()
+{
+    auto &monitor = audioProcessor.getLoadMonitor();
+    const int numRead = monitor.readStats(stats.data(), (int) stats.size());
+    if (numRead == 0) {
+        return;
+    }
+
+    recentPeakLoad = 0.0f;
+    for (int i = 0; i < numRead; ++i) {
+        const auto &s = stats[(size_t) i];
+        loadGraph.addBlock(s.load);
+        recentPeakLoad = juce::jmax(recentPeakLoad, s.load);
+        if (logStream != nullptr) {
+            *logStream << juce::String(s.time, 6) << "," << s.numSamples << "," << juce::String(s.renderMs, 4) << ","
+                       << juce::String(s.load, 4) << "," << s.activeVoices << "," << s.activeModes << ","
+                       << s.lowestNote << "," << s.highestNote << "," << s.modeLimit << "\n";
+        }
+    }
+    latest = stats[(size_t) numRead - 1];
+    peakLoad = juce::jmax(peakLoad, recentPeakLoad);
+
+    loadGraph.repaint();
+    updateCounters();
+}
+
+void StiffStringAudioProcessorEditor::updateCounters()
+{
+    auto &monitor = audioProcessor.getLoadMonitor();
+    juce::String text;
+    text << "Load " << juce::roundToInt(latest.load * 100.0f) << "% (recent peak "
+         << juce::roundToInt(recentPeakLoad * 100.0f) << "%, peak " << juce::roundToInt(peakLoad * 100.0f) << "%)   "
+         << "Voices " << latest.activeVoices << "   Modes " << latest.activeModes
+         << " (limit " << latest.modeLimit << " per voice)\n"
+         << "Overruns " << monitor.getNumOverruns() << " of " << monitor.getNumBlocks() << " blocks   "
+         << "Block " << latest.numSamples << " samples, " << juce::String(latest.renderMs, 3) << " ms";
+    countersLabel.setText(text, juce::dontSendNotification);
+}
+
+void StiffStringAudioProcessorEditor::setLogging(bool shouldLog)
+{
+    logStream.reset();
+    if (!shouldLog) {
+        return;
+    }
+
+    const auto file = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+        .getNonexistentChildFile("StiffString load " + juce::Time::getCurrentTime().formatted("%Y-%m-%d %H-%M-%S"), ".csv");
+    logStream = std::make_unique<juce::FileOutputStream>(file);
+    if (logStream->failedToOpen()) {
+        logStream.reset();
+        logButton.setToggleState(false, juce::dontSendNotification);
+        return;
+    }
+    *logStream << "time,samples,renderMs,load,voices,modes,lowestNote,highestNote,modeLimit\n";
+    logButton.setTooltip(file.getFullPathName());
 }
@@ -11,10 +11,27 @@
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
 
+//==============================================================================
+// Scrolling plot of the DSP load of recent blocks, as a fraction of each
+// block's deadline
+class LoadGraph : public juce::Component
+{
+public:
+    void addBlock(float load);
+    void paint(juce::Graphics &g) override;
+
+private:
+    static constexpr int historySize = 512;
+    static constexpr float maxLoad = 1.5f;  // top of the plot
+    std::array<float, historySize> history {};
+    int writeIndex = 0;
+};
+
 //==============================================================================
 /**
 */
-class StiffStringAudioProcessorEditor  : public juce::AudioProcessorEditor
+class StiffStringAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                         juce::Timer
 {
 public:
     StiffStringAudioProcessorEditor (StiffStringAudioProcessor&);
@@ -25,9 +42,33 @@ public:
     void resized() override;
 
 private:
+    void timerCallback() override;
+    void updateCounters();
+    void setLogging(bool shouldLog);
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     StiffStringAudioProcessor& audioProcessor;
 
+    juce::OwnedArray<juce::Label> parameterLabels;
+    juce::OwnedArray<juce::Slider> parameterSliders;
+    juce::ToggleButton parallelButton;
+    juce::ToggleButton governorButton;
+    juce::OwnedArray<juce::AudioProcessorValueTreeState::SliderAttachment> sliderAttachments;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> parallelAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> governorAttachment;
+
+    LoadGraph loadGraph;
+    juce::Label countersLabel;
+    juce::ToggleButton logButton { "Log load to file" };
+    juce::TextButton resetButton { "Reset peak" };
+
+    // stats read from the processor on each timer tick
+    std::vector<LoadMonitor::BlockStats> stats;
+    LoadMonitor::BlockStats latest {};
+    float recentPeakLoad = 0.0f;
+    float peakLoad = 0.0f;
+    std::unique_ptr<juce::FileOutputStream> logStream;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StiffStringAudioProcessorEditor)
 };
@@ -8,8 +8,8 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
-#include "SynthSound.h"
 #include "SynthVoice.h"
+#include "RealtimeWatchdog.h"
 
 //==============================================================================
 StiffStringAudioProcessor::StiffStringAudioProcessor() :
@@ -17,50 +17,71 @@ StiffStringAudioProcessor::StiffStringAudioProcessor() :
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                      #else
+                       .withInput  ("Excitation", juce::AudioChannelSet::mono(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
                        ),
-    params(*this, nullptr, "Parameters", createParams())
+    params(*this, nullptr, "Parameters", createParams()),
+    stiffnessParam(params.getRawParameterValue("STIFFNESS")),
+    pluckPosParam(params.getRawParameterValue("PLUCKPOS")),
+    decayParam(params.getRawParameterValue("DECAY")),
+    decayHighFreqParam(params.getRawParameterValue("DECAYHF")),
+    resonanceParam(params.getRawParameterValue("RESONANCE")),
+    pluckLevelParam(params.getRawParameterValue("PLUCK")),
+    driveParam(params.getRawParameterValue("DRIVE")),
+    parallelParam(params.getRawParameterValue("PARALLEL")),
+    governorParam(params.getRawParameterValue("GOVERNOR")),
+    numVoicesParam(params.getRawParameterValue("VOICES")),
+    numModesParam(params.getRawParameterValue("MODES"))
 {
     LEAF_init(&leaf, 48000, leafMemory, leafMemSize, []() { return (float) rand() / RAND_MAX; });
-
-    synth.addSound(new SynthSound());
-
-    for (int i=0; i < numVoices; ++i) {
-        synth.addVoice(new SynthVoice(&leaf, numModes));
+    for (int p = 0; p < ModalBank::maxPickups; ++p) {
+        pickupPosParams[(size_t) p] = params.getRawParameterValue(getPickupPosID(p));
     }
 
-    addListeners();
+    synth.setModalTables(&modalTables);
+    rebuildVoices();
+
+    params.addParameterListener("VOICES", this);
+    params.addParameterListener("MODES", this);
 }
 
 StiffStringAudioProcessor::~StiffStringAudioProcessor()
 {
-    removeListeners();
+    params.removeParameterListener("VOICES", this);
+    params.removeParameterListener("MODES", this);
+    cancelPendingUpdate();
 }
 
 //==============================================================================
 
 double StiffStringAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return SynthVoice::getReleaseTailSeconds(readParameters(), numModes, numPickups);
 }
 
 void StiffStringAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+    preparedSampleRate = sampleRate;
+    preparedBlockSize = samplesPerBlock;
     LEAF_setSampleRate(&leaf, sampleRate);
     synth.setCurrentPlaybackSampleRate(sampleRate);
-    for (int i = 0; i < synth.getNumVoices(); ++i) {
-        if (auto voice = static_cast<SynthVoice *>(synth.getVoice(i))) {
-            voice->prepareToPlay(sampleRate, samplesPerBlock, getTotalNumOutputChannels());
-        }
-    }
+    excitation.setSize(1, samplesPerBlock);
+    // the output layout is settled by now
+    rebuildVoices();
+    // leave one core for the audio thread, which also renders voices
+    const int numWorkers = juce::jlimit(0, maxRenderWorkers, juce::SystemStats::getNumCpus() - 1);
+    synth.prepare(samplesPerBlock, getTotalNumOutputChannels(), numWorkers);
+    currentParams = readParameters();
+    synth.setVoiceParameters(currentParams, 0);
+    modalTables.request(currentParams, sampleRate, numModes, numPickups);
 }
 
 void StiffStringAudioProcessor::releaseResources()
 {
-    // When playback stops, you can use this as an opportunity to free up any
-    // spare memory, etc.
+    synth.release();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -70,18 +91,20 @@ bool StiffStringAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Each output channel has a pickup of its own, so any layout from mono
+    // up to ModalBank::maxPickups channels will do
+    const int numOutputs = layouts.getMainOutputChannels();
+    if (numOutputs < 1 || numOutputs > ModalBank::maxPickups)
         return false;
 
     // This checks if the input layout matches the output layout
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+   #else
+    // the excitation input is mixed down to mono
+    if (layouts.getMainInputChannels() > 2)
+        return false;
    #endif
 
     return true;
@@ -92,10 +115,66 @@ bool StiffStringAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
 void StiffStringAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    const RealtimeWatchdog::Scope realtimeScope;
     // auto totalNumOutputChannels = getTotalNumOutputChannels();
+    loadMonitor.beginBlock();
 
+    auto newParams = readParameters();
+    if (newParams != currentParams) {
+        currentParams = newParams;
+        synth.setVoiceParameters(currentParams, buffer.getNumSamples());
+        modalTables.request(currentParams, getSampleRate(), numModes, numPickups);
+    }
+    modalTables.acquire();
+
+    synth.setParallelRendering(parallelParam->load() > 0.5f);
+    synth.setSympatheticResonance(resonanceParam->load());
+    synth.setPluckLevel(pluckLevelParam->load());
+
+    // the input shares the buffer with the output, so read it first
+    const float *input = readExcitation(buffer);
     buffer.clear();
-    synth.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
+    synth.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples(), input);
+    governQuality(recordLoad(buffer.getNumSamples()));
+}
+
+const float *StiffStringAudioProcessor::readExcitation(const juce::AudioBuffer<float> &buffer)
+{
+    const float drive = driveParam->load();
+    const int numSamples = buffer.getNumSamples();
+    if (drive <= 0.0f || getBusCount(true) == 0 || numSamples > excitation.getNumSamples()) {
+        return nullptr;
+    }
+    const auto input = getBusBuffer(buffer, true, 0);
+    const int numChannels = input.getNumChannels();
+    if (numChannels == 0) {
+        return nullptr;
+    }
+    float *dest = excitation.getWritePointer(0);
+    const float gain = drive / (float) numChannels;
+    juce::FloatVectorOperations::copyWithMultiply(dest, input.getReadPointer(0), gain, numSamples);
+    for (int ch = 1; ch < numChannels; ++ch) {
+        juce::FloatVectorOperations::addWithMultiply(dest, input.getReadPointer(ch), gain, numSamples);
+    }
+    return dest;
+}
+
+void StiffStringAudioProcessor::governQuality(float load)
+{
+    // the load of an offline render says nothing about real time
+    const bool governed = governorParam->load() > 0.5f && !isNonRealtime();
+    if (!governed || governor.getMaxModes() != numModes) {
+        governor.reset(numModes);
+    }
+    modeLimit = governed ? governor.update(load) : governor.getModeLimit();
+    synth.setModeLimit(modeLimit);
+}
+
+float StiffStringAudioProcessor::recordLoad(int numSamples)
+{
+    const auto &activity = synth.getActivity();
+    return loadMonitor.endBlock(numSamples, getSampleRate(), activity.numVoices, activity.numModes,
+                                activity.lowestNote, activity.highestNote, modeLimit);
 }
 
 //==============================================================================
@@ -106,22 +185,24 @@ bool StiffStringAudioProcessor::hasEditor() const
 
 juce::AudioProcessorEditor* StiffStringAudioProcessor::createEditor()
 {
-    //return new StiffStringAudioProcessorEditor (*this);
-    return new juce::GenericAudioProcessorEditor(*this);
+    return new StiffStringAudioProcessorEditor (*this);
 }
 
 //==============================================================================
 void StiffStringAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    if (auto xml = params.copyState().createXml()) {
+        copyXmlToBinary(*xml, destData);
+    }
 }
 
 void StiffStringAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    if (auto xml = getXmlFromBinary(data, sizeInBytes)) {
+        if (xml->hasTagName(params.state.getType())) {
+            params.replaceState(juce::ValueTree::fromXml(*xml));
+        }
+    }
 }
 
 //==============================================================================
@@ -138,71 +219,88 @@ juce::AudioProcessorValueTreeState::ParameterLayout StiffStringAudioProcessor::c
     params.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{ "STIFFNESS", 1}, "Stiffness", juce::NormalisableRange<float> { 0.0f, 3.0f, 0.001f }, 0.01f, ""));
     params.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{ "PLUCKPOS", 1}, "Pluck pos", juce::NormalisableRange<float> { 0.01f, 0.99f, 0.01f }, 0.2f, ""));
     params.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{ "PICKUPPOS", 1}, "Pickup pos", juce::NormalisableRange<float> { 0.01f, 0.99f, 0.01f }, 0.1f, ""));
+    for (int p = 1; p < ModalBank::maxPickups; ++p) {
+        params.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{ getPickupPosID(p), 1}, "Pickup " + juce::String(p + 1) + " pos", juce::NormalisableRange<float> { 0.01f, 0.99f, 0.01f }, 0.1f + 0.05f * p, ""));
+    }
     params.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{ "DECAY", 1}, "Decay", juce::NormalisableRange<float> { 0.0f, 0.01f, 0.0001f }, 0.001f, ""));
     params.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{ "DECAYHF", 1}, "Decay HF", juce::NormalisableRange<float> { 0.0f, 0.01f, 0.0001f }, 0.001f, ""));
+    params.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{ "RESONANCE", 1}, "Sympathetic resonance", juce::NormalisableRange<float> { 0.0f, 1.0f, 0.01f }, 0.0f, ""));
+    params.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{ "PLUCK", 1}, "Pluck level", juce::NormalisableRange<float> { 0.0f, 1.0f, 0.01f }, 1.0f, ""));
+    params.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{ "DRIVE", 1}, "Input drive", juce::NormalisableRange<float> { 0.0f, 1.0f, 0.001f, 0.3f }, 0.0f, ""));
+    params.push_back(std::make_unique<juce::AudioParameterBool>(juce::ParameterID{ "PARALLEL", 1}, "Multi-core rendering", false, juce::AudioParameterBoolAttributes().withAutomatable(false)));
+    params.push_back(std::make_unique<juce::AudioParameterBool>(juce::ParameterID{ "GOVERNOR", 1}, "Shed modes under load", true, juce::AudioParameterBoolAttributes().withAutomatable(false)));
+    params.push_back(std::make_unique<juce::AudioParameterInt>(juce::ParameterID{ "VOICES", 1}, "Polyphony", 1, 64, 6, juce::AudioParameterIntAttributes().withAutomatable(false)));
+    params.push_back(std::make_unique<juce::AudioParameterInt>(juce::ParameterID{ "MODES", 1}, "Modes", 8, 512, 32, juce::AudioParameterIntAttributes().withAutomatable(false)));
 
     return { params.begin(), params.end() };
 }
 
-void StiffStringAudioProcessor::addListeners()
+juce::String StiffStringAudioProcessor::getPickupPosID(int pickup)
 {
-    params.addParameterListener("STIFFNESS", this);
-    params.addParameterListener("PLUCKPOS", this);
-    params.addParameterListener("PICKUPPOS", this);
-    params.addParameterListener("DECAY", this);
-    params.addParameterListener("DECAYHF", this);
+    return pickup == 0 ? juce::String("PICKUPPOS") : "PICKUPPOS" + juce::String(pickup + 1);
 }
 
-void StiffStringAudioProcessor::removeListeners()
+StiffString::Parameters StiffStringAudioProcessor::readParameters() const
 {
-    params.removeParameterListener("STIFFNESS", this);
-    params.removeParameterListener("PLUCKPOS", this);
-    params.removeParameterListener("PICKUPPOS", this);
-    params.removeParameterListener("DECAY", this);
-    params.removeParameterListener("DECAYHF", this);
+    StiffString::Parameters p;
+    p.stiffness = stiffnessParam->load();
+    p.pluckPos = pluckPosParam->load();
+    for (size_t i = 0; i < p.pickupPos.size(); ++i) {
+        p.pickupPos[i] = pickupPosParams[i]->load();
+    }
+    p.decay = decayParam->load();
+    p.decayHighFreq = decayHighFreqParam->load();
+    return p;
 }
 
 void StiffStringAudioProcessor::parameterChanged(const juce::String &parameterID, float newValue)
 {
-    if (parameterID == "STIFFNESS") {
-        for (int i = 0; i < synth.getNumVoices(); ++i) {
-            if (auto voice = static_cast<SynthVoice *>(synth.getVoice(i))) {
-                voice->setStiffness(newValue);
-            }
-        }
-        return;
-    }
-    if (parameterID == "PLUCKPOS") {
-        for (int i = 0; i < synth.getNumVoices(); ++i) {
-            if (auto voice = static_cast<SynthVoice *>(synth.getVoice(i))) {
-                voice->setPluckPos(newValue);
-            }
-        }
+    // may be called on any thread, so defer the rebuild to the message thread
+    triggerAsyncUpdate();
+}
+
+void StiffStringAudioProcessor::handleAsyncUpdate()
+{
+    rebuildVoices();
+}
+
+void StiffStringAudioProcessor::rebuildVoices()
+{
+    const int newNumVoices = (int) numVoicesParam->load();
+    const int newNumModes = (int) numModesParam->load();
+    const int newNumPickups = juce::jlimit(1, ModalBank::maxPickups, getTotalNumOutputChannels());
+    if (newNumVoices == numVoices && newNumModes == numModes && newNumPickups == numPickups) {
         return;
     }
-    if (parameterID == "PICKUPPOS") {
-        for (int i = 0; i < synth.getNumVoices(); ++i) {
-            if (auto voice = static_cast<SynthVoice *>(synth.getVoice(i))) {
-                voice->setPickupPos(newValue);
-            }
-        }
-        return;
+
+    // build the new voices in a fresh arena, off the audio thread
+    auto arena = std::make_unique<VoiceArena>(newNumVoices, SynthVoice::getStorageSize(newNumModes, newNumPickups));
+    StringEngine::VoiceList voices;
+    const auto voiceParams = readParameters();
+    // the voices copy their pickup weights from shapes shared across the
+    // process, rather than each computing them
+    std::array<std::shared_ptr<const ModalTables::PickupShape>, ModalBank::maxPickups> shapes;
+    std::array<const float *, ModalBank::maxPickups> shapeData {};
+    for (int p = 0; p < newNumPickups; ++p) {
+        shapes[(size_t) p] = modalTables.getCache().getPickupShape(voiceParams.pickupPos[(size_t) p], newNumModes);
+        shapeData[(size_t) p] = shapes[(size_t) p]->values.data();
     }
-    if (parameterID == "DECAY") {
-        for (int i = 0; i < synth.getNumVoices(); ++i) {
-            if (auto voice = static_cast<SynthVoice *>(synth.getVoice(i))) {
-                voice->setDecay(newValue);
-            }
+    for (int i = 0; i < newNumVoices; ++i) {
+        auto voice = std::make_unique<SynthVoice>(&leaf, newNumModes, newNumPickups, arena->getVoiceStorage(i),
+                                                  &modalTables);
+        if (preparedSampleRate > 0.0) {
+            voice->prepareToPlay(preparedSampleRate, preparedBlockSize, getTotalNumOutputChannels());
         }
-        return;
+        voice->setParameters(voiceParams, 0, shapeData.data());
+        voices.push_back(std::move(voice));
     }
-    if (parameterID == "DECAYHF") {
-        for (int i = 0; i < synth.getNumVoices(); ++i) {
-            if (auto voice = static_cast<SynthVoice *>(synth.getVoice(i))) {
-                voice->setDecayHighFreq(newValue);
-            }
-        }
-        return;
+
+    synth.setVoices(voices, arena);
+    numVoices = newNumVoices;
+    numModes = newNumModes;
+    numPickups = newNumPickups;
+    if (preparedSampleRate > 0.0) {
+        modalTables.request(voiceParams, preparedSampleRate, newNumModes, newNumPickups);
     }
-    DBG("Changed " << parameterID << " : " << newValue);
+    // the old voices and arena are freed here, on this thread
 }
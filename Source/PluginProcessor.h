@@ -9,11 +9,18 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "StiffString.h"
+#include "StringEngine.h"
+#include "LoadMonitor.h"
+#include "ModalTables.h"
+#include "QualityGovernor.h"
 
 //==============================================================================
 /**
 */
-class StiffStringAudioProcessor  : public juce::AudioProcessor, juce::AudioProcessorValueTreeState::Listener
+class StiffStringAudioProcessor  : public juce::AudioProcessor,
+                                   juce::AudioProcessorValueTreeState::Listener,
+                                   juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -53,18 +60,70 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
     
-    const juce::AudioProcessorValueTreeState& getParams() { return params; }
+    juce::AudioProcessorValueTreeState& getParams() { return params; }
+    LoadMonitor& getLoadMonitor() { return loadMonitor; }
+
+    // one pickup for each output channel, up to ModalBank::maxPickups
+    int getNumPickups() const { return numPickups; }
+    // "PICKUPPOS" for the first pickup, then "PICKUPPOS2" and so on
+    static juce::String getPickupPosID(int pickup);
+    // A snapshot of the parameters the voices play with
+    StiffString::Parameters readParameters() const;
+
+    // Rebuild the voices now if the polyphony or mode count has changed,
+    // rather than waiting for the message loop (for the offline renderer)
+    void applyPendingSettings() { handleUpdateNowIfNeeded(); }
     
 private:
-    const int numVoices = 6;
-    const int numModes = 32;
-    juce::Synthesiser synth;
+    std::atomic<int> numVoices { 0 };
+    std::atomic<int> numModes { 0 };
+    std::atomic<int> numPickups { 0 };
+    const static int maxRenderWorkers = 15;
+    // shared by the voices, so must outlive them
+    ModalTables modalTables;
+    StringEngine synth;
+    LoadMonitor loadMonitor;
+    float recordLoad(int numSamples);
+
+    // The excitation input, mixed down to mono and scaled by the drive, or
+    // nullptr if it is off
+    const float *readExcitation(const juce::AudioBuffer<float> &buffer);
+    juce::AudioBuffer<float> excitation;
+
+    // Under load, limit the modes each voice renders
+    QualityGovernor governor;
+    int modeLimit = 0;
+    void governQuality(float load);
 
     juce::AudioProcessorValueTreeState params;
     juce::AudioProcessorValueTreeState::ParameterLayout createParams();
-    void addListeners();
-    void removeListeners();
+
+    // The host may change parameters from any thread, so the audio thread
+    // takes a snapshot of them once per block, and only passes it on to the
+    // voices when something has changed.
+    std::atomic<float> *stiffnessParam;
+    std::atomic<float> *pluckPosParam;
+    std::array<std::atomic<float> *, ModalBank::maxPickups> pickupPosParams;
+    std::atomic<float> *decayParam;
+    std::atomic<float> *decayHighFreqParam;
+    std::atomic<float> *resonanceParam;
+    std::atomic<float> *pluckLevelParam;
+    std::atomic<float> *driveParam;
+    std::atomic<float> *parallelParam;
+    std::atomic<float> *governorParam;
+    std::atomic<float> *numVoicesParam;
+    std::atomic<float> *numModesParam;
+    StiffString::Parameters currentParams;
+
+    // Polyphony and mode count are settings rather than automatable
+    // parameters.  Changing either rebuilds the voices on the message thread.
+    // So does a change in the number of output channels, which sets the
+    // number of pickups, when the host next prepares to play.
     void parameterChanged(const juce::String &parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+    void rebuildVoices();
+    double preparedSampleRate = 0.0;
+    int preparedBlockSize = 0;
 
     const static int leafMemSize = 32;
     char leafMemory[leafMemSize];
@@ -0,0 +1,38 @@
+/*
+  ==============================================================================
+
+    QualityGovernor.cpp
+    Created: 17 Oct 2026 4:59:10am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#include "QualityGovernor.h"
+
+void QualityGovernor::reset(int newMaxModes)
+{
+    maxModes = newMaxModes;
+    modeLimit = newMaxModes;
+    smoothedLoad = 0.0f;
+    blocksSinceChange = 0;
+}
+
+int QualityGovernor::update(float load)
+{
+    smoothedLoad += smoothing * (load - smoothedLoad);
+    ++blocksSinceChange;
+
+    if (load > 1.0f) {
+        // an overrun: cut hard, straight away
+        modeLimit = juce::jmax(juce::jmin(minModes, maxModes), (int) (modeLimit * 0.6f));
+        blocksSinceChange = 0;
+    } else if (smoothedLoad > highLoad && blocksSinceChange >= shedInterval) {
+        modeLimit = juce::jmax(juce::jmin(minModes, maxModes), (int) (modeLimit * 0.85f));
+        blocksSinceChange = 0;
+    } else if (smoothedLoad < lowLoad && modeLimit < maxModes && blocksSinceChange >= restoreInterval) {
+        modeLimit = juce::jmin(maxModes, modeLimit + juce::jmax(1, modeLimit / 8));
+        blocksSinceChange = 0;
+    }
+    return modeLimit;
+}
@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    QualityGovernor.h
+    Created: 17 Oct 2026 4:59:10am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Chooses how many modes each voice may render, from the measured DSP load,
+// so that a heavy passage loses its quietest partials rather than dropping
+// out.  The limit falls quickly when the load nears the deadline, and
+// climbs back slowly once there is headroom again.
+class QualityGovernor {
+public:
+    // Start again with no limit, for voices with maxModes modes
+    void reset(int maxModes);
+    int getMaxModes() const { return maxModes; }
+
+    // Feed the load of the last block, as a fraction of its deadline, and
+    // return the per-voice mode limit to apply
+    int update(float load);
+    int getModeLimit() const { return modeLimit; }
+
+private:
+    // shed modes while the smoothed load is above this
+    static constexpr float highLoad = 0.7f;
+    // and bring them back while it is below this
+    static constexpr float lowLoad = 0.45f;
+    static constexpr float smoothing = 0.2f;
+    static constexpr int minModes = 8;
+    // blocks to wait after a change before the next, to see its effect
+    static constexpr int shedInterval = 2;
+    static constexpr int restoreInterval = 16;
+
+    int maxModes = 0;
+    int modeLimit = 0;
+    float smoothedLoad = 0.0f;
+    int blocksSinceChange = 0;
+};
@@ -0,0 +1,343 @@
+/*
+  ==============================================================================
+
+    RealtimeWatchdog.cpp
+    Created: 17 Oct 2026 6:31:18am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+// the fortified inline read and write would clash with the wrappers
+#undef _FORTIFY_SOURCE
+
+#include "RealtimeWatchdog.h"
+
+#include <cerrno>
+#include <cstdarg>
+
+#if STIFFSTRING_RT_WATCHDOG
+
+#if JUCE_LINUX
+ #include <dlfcn.h>
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <pthread.h>
+ #include <semaphore.h>
+ #include <time.h>
+ #include <unistd.h>
+#endif
+
+namespace {
+
+std::atomic<int> numViolations { 0 };
+// only the first few are reported in full, as a dropout tends to repeat
+constexpr int maxReports = 32;
+
+// Plain ints, so that touching them never allocates
+thread_local int scopeDepth = 0;
+// set while reporting, which allocates and writes, so that the report is
+// not reported in turn
+thread_local bool reporting = false;
+
+void report(const char *what)
+{
+    reporting = true;
+    const int count = ++numViolations;
+    if (count <= maxReports) {
+        std::cerr << "Real-time violation: " << what << " on a real-time thread\n"
+                  << juce::SystemStats::getStackBacktrace() << std::endl;
+        if (count == maxReports) {
+            std::cerr << "Further real-time violations are counted but not reported" << std::endl;
+        }
+    }
+    reporting = false;
+}
+
+inline void check(const char *what)
+{
+    if (scopeDepth > 0 && !reporting) {
+        report(what);
+    }
+}
+
+#if JUCE_LINUX
+// the next definition of a wrapped function, normally the C library's
+template <typename Function>
+Function getNext(const char *name)
+{
+    return reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+}
+#endif
+
+}
+
+RealtimeWatchdog::Scope::Scope()
+{
+    ++scopeDepth;
+}
+
+RealtimeWatchdog::Scope::~Scope()
+{
+    --scopeDepth;
+}
+
+int RealtimeWatchdog::getNumViolations()
+{
+    return numViolations.load();
+}
+
+#if JUCE_LINUX
+
+// Memory, through glibc's own allocator, which operator new also ends up in.
+// These can't go through dlsym, which itself allocates.
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) noexcept
+{
+    check("malloc");
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+    check("calloc");
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) noexcept
+{
+    check("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) noexcept
+{
+    check("memalign");
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    check("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **result, size_t alignment, size_t size) noexcept
+{
+    check("posix_memalign");
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void *ptr = __libc_memalign(alignment, size);
+    if (ptr == nullptr) {
+        return ENOMEM;
+    }
+    *result = ptr;
+    return 0;
+}
+
+void free(void *ptr) noexcept
+{
+    if (ptr != nullptr) {
+        check("free");
+    }
+    __libc_free(ptr);
+}
+
+// Locks
+int pthread_mutex_lock(pthread_mutex_t *mutex) noexcept
+{
+    static const auto next = getNext<int (*)(pthread_mutex_t *)>("pthread_mutex_lock");
+    check("pthread_mutex_lock");
+    return next(mutex);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t *lock) noexcept
+{
+    static const auto next = getNext<int (*)(pthread_rwlock_t *)>("pthread_rwlock_rdlock");
+    check("pthread_rwlock_rdlock");
+    return next(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t *lock) noexcept
+{
+    static const auto next = getNext<int (*)(pthread_rwlock_t *)>("pthread_rwlock_wrlock");
+    check("pthread_rwlock_wrlock");
+    return next(lock);
+}
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+    static const auto next = getNext<int (*)(pthread_cond_t *, pthread_mutex_t *)>("pthread_cond_wait");
+    check("pthread_cond_wait");
+    return next(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *time)
+{
+    static const auto next = getNext<int (*)(pthread_cond_t *, pthread_mutex_t *, const struct timespec *)>(
+        "pthread_cond_timedwait");
+    check("pthread_cond_timedwait");
+    return next(cond, mutex, time);
+}
+
+int pthread_join(pthread_t thread, void **result)
+{
+    static const auto next = getNext<int (*)(pthread_t, void **)>("pthread_join");
+    check("pthread_join");
+    return next(thread, result);
+}
+
+int sem_wait(sem_t *sem)
+{
+    static const auto next = getNext<int (*)(sem_t *)>("sem_wait");
+    check("sem_wait");
+    return next(sem);
+}
+
+int sem_timedwait(sem_t *sem, const struct timespec *time)
+{
+    static const auto next = getNext<int (*)(sem_t *, const struct timespec *)>("sem_timedwait");
+    check("sem_timedwait");
+    return next(sem, time);
+}
+
+// Blocking system calls
+int nanosleep(const struct timespec *duration, struct timespec *remaining)
+{
+    static const auto next = getNext<int (*)(const struct timespec *, struct timespec *)>("nanosleep");
+    check("nanosleep");
+    return next(duration, remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec *time, struct timespec *remaining)
+{
+    static const auto next = getNext<int (*)(clockid_t, int, const struct timespec *, struct timespec *)>(
+        "clock_nanosleep");
+    check("clock_nanosleep");
+    return next(clock, flags, time, remaining);
+}
+
+int usleep(useconds_t microseconds)
+{
+    static const auto next = getNext<int (*)(useconds_t)>("usleep");
+    check("usleep");
+    return next(microseconds);
+}
+
+unsigned int sleep(unsigned int seconds)
+{
+    static const auto next = getNext<unsigned int (*)(unsigned int)>("sleep");
+    check("sleep");
+    return next(seconds);
+}
+
+int open(const char *path, int flags, ...)
+{
+    static const auto next = getNext<int (*)(const char *, int, ...)>("open");
+    check("open");
+    mode_t mode = 0;
+    if ((flags & O_CREAT) != 0 || (flags & O_TMPFILE) == O_TMPFILE) {
+        va_list args;
+        va_start(args, flags);
+        mode = (mode_t) va_arg(args, int);
+        va_end(args);
+    }
+    return next(path, flags, mode);
+}
+
+int close(int fd)
+{
+    static const auto next = getNext<int (*)(int)>("close");
+    check("close");
+    return next(fd);
+}
+
+ssize_t read(int fd, void *buffer, size_t count)
+{
+    static const auto next = getNext<ssize_t (*)(int, void *, size_t)>("read");
+    check("read");
+    return next(fd, buffer, count);
+}
+
+ssize_t write(int fd, const void *buffer, size_t count)
+{
+    static const auto next = getNext<ssize_t (*)(int, const void *, size_t)>("write");
+    check("write");
+    return next(fd, buffer, count);
+}
+
+int fsync(int fd)
+{
+    static const auto next = getNext<int (*)(int)>("fsync");
+    check("fsync");
+    return next(fd);
+}
+
+int poll(struct pollfd *fds, nfds_t numFds, int timeout)
+{
+    static const auto next = getNext<int (*)(struct pollfd *, nfds_t, int)>("poll");
+    check("poll");
+    return next(fds, numFds, timeout);
+}
+
+}
+
+#else
+
+// Elsewhere the C library can't be wrapped, but operator new and delete can
+// be replaced
+void *operator new(std::size_t size)
+{
+    check("operator new");
+    if (void *ptr = std::malloc(size > 0 ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    if (ptr != nullptr) {
+        check("operator delete");
+    }
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+#endif
+
+#else
+
+int RealtimeWatchdog::getNumViolations()
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,48 @@
+/*
+  ==============================================================================
+
+    RealtimeWatchdog.h
+    Created: 17 Oct 2026 6:31:18am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Build with STIFFSTRING_RT_WATCHDOG=1 to catch the audio thread doing what it
+// must not, as the Watchdog configuration of Tools/OfflineRender does
+#ifndef STIFFSTRING_RT_WATCHDOG
+ #define STIFFSTRING_RT_WATCHDOG 0
+#endif
+
+// A debugging aid that reports, with a stack trace on stderr, each memory
+// allocation, lock or blocking system call made by a thread while it is in a
+// Scope.  The audio thread holds a Scope for the whole of processBlock, and
+// render workers for each job they run for it.
+//
+// The checks work by replacing malloc and friends, the pthread locks and the
+// blocking POSIX calls with wrappers, so they see only the calls made within
+// an executable that links them in: the standalone plugin and the tools.  A
+// plugin loaded by a host keeps the C library's own.  Linux gets the full
+// set; elsewhere only operator new and delete are wrapped.  A lock that never
+// calls into the C library, such as juce::SpinLock, is not seen.  Without the
+// build option, a Scope is empty and nothing is replaced.
+class RealtimeWatchdog {
+public:
+    class Scope {
+    public:
+       #if STIFFSTRING_RT_WATCHDOG
+        Scope();
+        ~Scope();
+       #else
+        Scope() {}
+       #endif
+        JUCE_DECLARE_NON_COPYABLE (Scope)
+    };
+
+    // the number of violations seen so far, in every thread
+    static int getNumViolations();
+};
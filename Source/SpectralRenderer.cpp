@@ -0,0 +1,227 @@
+/*
+  ==============================================================================
+
+    SpectralRenderer.cpp
+    Created: 17 Oct 2026 4:41:05am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#include "SpectralRenderer.h"
+
+namespace {
+// 4-term Nuttall window with continuous first derivative: it is zero at the
+// ends, so its spectrum about the frame centre is real and even
+constexpr double windowCoefs[] = { 0.355768, 0.487396, 0.144232, 0.012604 };
+}
+
+SpectralRenderer::SpectralRenderer(int maxModes, int numPickups, float *storage) :
+    kernel(getKernel()),
+    fft(fftOrder),
+    numPickups(numPickups),
+    hopRe(storage),
+    hopIm(hopRe + VoiceArena::roundUp((size_t) maxModes)),
+    rotRe(hopIm + VoiceArena::roundUp((size_t) maxModes)),
+    rotIm(rotRe + VoiceArena::roundUp((size_t) maxModes)),
+    bins(rotIm + VoiceArena::roundUp((size_t) maxModes))
+{
+    jassert(numPickups >= 1 && numPickups <= ModalBank::maxPickups);
+    float *next = bins + VoiceArena::roundUp((size_t) maxModes);
+    for (int p = 0; p < numPickups; ++p) {
+        spectrum[p] = next;
+        overlap[p] = spectrum[p] + VoiceArena::roundUp(2 * frameSize);
+        next = overlap[p] + VoiceArena::roundUp(frameSize);
+        std::fill(overlap[p], overlap[p] + frameSize, 0.0f);
+    }
+}
+
+size_t SpectralRenderer::getStorageSize(int maxModes, int numPickups)
+{
+    return 5 * VoiceArena::roundUp((size_t) maxModes)
+         + (size_t) numPickups * (VoiceArena::roundUp(2 * frameSize) + VoiceArena::roundUp(frameSize));
+}
+
+const float *SpectralRenderer::getKernel()
+{
+    // The spectrum of the window, centred on the frame, at fractional bin
+    // offsets from 0 to kernelHalfWidth, scaled so that the overlapping
+    // windows sum to one
+    static const std::vector<float> kernel = [] {
+        const int size = kernelHalfWidth * kernelOversampling + 2;
+        std::vector<float> k((size_t) size, 0.0f);
+        std::vector<double> window(frameSize);
+        for (int n = 0; n < frameSize; ++n) {
+            const double x = juce::MathConstants<double>::twoPi * n / frameSize;
+            window[(size_t) n] = windowCoefs[0] - windowCoefs[1] * std::cos(x)
+                               + windowCoefs[2] * std::cos(2.0 * x) - windowCoefs[3] * std::cos(3.0 * x);
+        }
+        const double windowSum = 4.0 * windowCoefs[0];
+        for (int i = 0; i <= kernelHalfWidth * kernelOversampling; ++i) {
+            const double offset = (double) i / kernelOversampling;
+            double sum = 0.0;
+            for (int n = 0; n < frameSize; ++n) {
+                sum += window[(size_t) n] * std::cos(juce::MathConstants<double>::twoPi * offset * (n - frameSize / 2) / frameSize);
+            }
+            k[(size_t) i] = (float) (sum / windowSum);
+        }
+        return k;
+    }();
+    return kernel.data();
+}
+
+void SpectralRenderer::removeMode(int i, int last)
+{
+    hopRe[i] = hopRe[last];
+    hopIm[i] = hopIm[last];
+    rotRe[i] = rotRe[last];
+    rotIm[i] = rotIm[last];
+    bins[i] = bins[last];
+}
+
+void SpectralRenderer::updateCoefficients(const ModalBank &bank)
+{
+    const auto &b = bank.getBuffers();
+    for (int i = 0; i < bank.getNumModes(); ++i) {
+        const float radius = std::sqrt(b.coefRe[i] * b.coefRe[i] + b.coefIm[i] * b.coefIm[i]);
+        const float omega = std::atan2(b.coefIm[i], b.coefRe[i]);
+        const float decay = std::pow(radius, (float) hopSize);
+        rotRe[i] = std::cos(omega * hopSize);
+        rotIm[i] = std::sin(omega * hopSize);
+        hopRe[i] = decay * rotRe[i];
+        hopIm[i] = decay * rotIm[i];
+        bins[i] = omega * (frameSize / juce::MathConstants<float>::twoPi);
+    }
+    needsCoefficients = false;
+}
+
+void SpectralRenderer::start(const ModalBank &bank)
+{
+    // The phasors hold each mode's value now.  Synthesize the three frames
+    // that started before now, and keep only their samples from now on, so
+    // that the note starts on this sample rather than fading in.  The first
+    // of these is centred a hop in the past; its amplitude is not
+    // extrapolated backwards, where a fast decay would blow it up.
+    updateCoefficients(bank);
+    for (int p = 0; p < numPickups; ++p) {
+        std::fill(overlap[p], overlap[p] + frameSize, 0.0f);
+    }
+
+    const auto &b = bank.getBuffers();
+    const int n = bank.getNumModes();
+    for (int i = 0; i < n; ++i) {
+        const float re = b.re[i] * rotRe[i] + b.im[i] * rotIm[i];
+        b.im[i] = b.im[i] * rotRe[i] - b.re[i] * rotIm[i];
+        b.re[i] = re;
+    }
+    synthesizeFrame(bank, 3 * hopSize);
+    for (int i = 0; i < n; ++i) {
+        const float re = b.re[i] * rotRe[i] - b.im[i] * rotIm[i];
+        b.im[i] = b.im[i] * rotRe[i] + b.re[i] * rotIm[i];
+        b.re[i] = re;
+    }
+    for (int skip = 2 * hopSize; skip >= 0; skip -= hopSize) {
+        synthesizeFrame(bank, skip);
+        advance(bank);
+    }
+    hopPosition = 0;
+    needsRestart = false;
+}
+
+void SpectralRenderer::advance(const ModalBank &bank)
+{
+    const auto &b = bank.getBuffers();
+    for (int i = 0; i < bank.getNumModes(); ++i) {
+        const float re = b.re[i] * hopRe[i] - b.im[i] * hopIm[i];
+        b.im[i] = b.re[i] * hopIm[i] + b.im[i] * hopRe[i];
+        b.re[i] = re;
+    }
+}
+
+void SpectralRenderer::nextHop(const ModalBank &bank)
+{
+    for (int p = 0; p < numPickups; ++p) {
+        std::copy(overlap[p] + hopSize, overlap[p] + frameSize, overlap[p]);
+        std::fill(overlap[p] + frameSize - hopSize, overlap[p] + frameSize, 0.0f);
+    }
+    synthesizeFrame(bank, 0);
+    advance(bank);
+    hopPosition = 0;
+}
+
+void SpectralRenderer::synthesizeFrame(const ModalBank &bank, int skip)
+{
+    // A mode with value u at the frame centre and frequency f bins, windowed,
+    // has spectrum (-1)^k u K(k - f) / (2i) at bin k, plus the mirror image
+    // at negative frequencies, where K is the window's spectrum.
+    constexpr int halfSize = frameSize / 2;
+    const auto &b = bank.getBuffers();
+    for (int p = 0; p < numPickups; ++p) {
+        std::fill(spectrum[p], spectrum[p] + frameSize + 2, 0.0f);
+    }
+
+    for (int i = 0; i < bank.getNumModes(); ++i) {
+        // u / 2i, given the weight of each pickup in turn
+        const float uRe = 0.5f * b.im[i];
+        const float uIm = -0.5f * b.re[i];
+        const float f = bins[i];
+        const int first = (int) std::ceil(f - kernelHalfWidth);
+        for (int k = first; k < first + 2 * kernelHalfWidth; ++k) {
+            const float pos = std::abs(k - f) * kernelOversampling;
+            const int index = (int) pos;
+            const float frac = pos - index;
+            float gain = kernel[index] + frac * (kernel[index + 1] - kernel[index]);
+            if (k & 1) {
+                gain = -gain;
+            }
+            const bool inRange = k >= 0 && k <= halfSize;
+            // mirror images, from below zero and above Nyquist
+            const int mirror = k <= 0 ? -k : frameSize - k;
+            const bool mirrored = mirror >= 0 && mirror <= halfSize && (k <= 0 || k >= halfSize);
+            for (int p = 0; p < numPickups; ++p) {
+                const float re = gain * b.weight[p][i] * uRe;
+                const float im = gain * b.weight[p][i] * uIm;
+                if (inRange) {
+                    spectrum[p][2 * k] += re;
+                    spectrum[p][2 * k + 1] += im;
+                }
+                if (mirrored) {
+                    spectrum[p][2 * mirror] += re;
+                    spectrum[p][2 * mirror + 1] -= im;
+                }
+            }
+        }
+    }
+
+    for (int p = 0; p < numPickups; ++p) {
+        fft.performRealOnlyInverseTransform(spectrum[p]);
+        juce::FloatVectorOperations::add(overlap[p], spectrum[p] + skip, frameSize - skip);
+    }
+}
+
+void SpectralRenderer::process(const ModalBank &bank, float *const *channels, int numChannels, int numSamples,
+                               float gain, bool accumulate)
+{
+    if (needsRestart) {
+        start(bank);
+    } else if (needsCoefficients) {
+        updateCoefficients(bank);
+    }
+
+    for (int done = 0; done < numSamples; ) {
+        if (hopPosition == hopSize) {
+            nextHop(bank);
+        }
+        const int n = juce::jmin(hopSize - hopPosition, numSamples - done);
+        for (int ch = 0; ch < numChannels; ++ch) {
+            const float *src = overlap[ch % numPickups] + hopPosition;
+            if (accumulate) {
+                juce::FloatVectorOperations::addWithMultiply(channels[ch] + done, src, gain, n);
+            } else {
+                juce::FloatVectorOperations::copyWithMultiply(channels[ch] + done, src, gain, n);
+            }
+        }
+        hopPosition += n;
+        done += n;
+    }
+}
@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    SpectralRenderer.h
+    Created: 17 Oct 2026 4:41:05am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ModalBank.h"
+
+// Renders the modes of a ModalBank by inverse FFT with overlap-add, rather
+// than advancing each mode sample by sample.  Each frame is the sum of the
+// modes, held at their amplitude and phase at the frame's centre and shaped
+// by a window, written straight into the spectrum: a windowed sinusoid only
+// touches the handful of bins under the window's main lobe.  The cost per
+// hop is then O(modes * kernelWidth + N log N), instead of O(modes * hop).
+//
+// The window is a 4-term Nuttall window, whose shifted copies sum to a
+// constant at a hop of a quarter frame, and whose sidelobes are below
+// -93 dB, so the spectrum can be truncated to the main lobe.  Each mode's
+// amplitude is interpolated from one frame to the next by the overlapping
+// windows, which is accurate as long as the mode decays slowly over a hop.
+//
+// While the renderer is in use, the bank's phasors hold each mode's value
+// at the centre of the next frame to be synthesized, and the bank's own
+// kernels are not used.  Parameter changes take effect from the next frame,
+// so they crossfade over a frame.
+//
+// Each of the bank's pickups has its own spectrum, filled in the same pass
+// over the modes, and its own inverse FFT.
+class SpectralRenderer {
+public:
+    // storage must hold getStorageSize(maxModes, numPickups) floats
+    SpectralRenderer(int maxModes, int numPickups, float *storage);
+
+    static size_t getStorageSize(int maxModes, int numPickups);
+
+    // The bank's phasors were reset (a pluck): start again from them at the
+    // next sample rendered, discarding the overlap still to be played
+    void restart() { needsRestart = true; }
+    // The bank's coefficients changed: pick them up from the next frame
+    void coefficientsChanged() { needsCoefficients = true; }
+    // Mirror ModalBank::removeMode, for the mode about to be removed
+    void removeMode(int i, int last);
+
+    // Write (or add, if accumulate) gain times the next numSamples samples of
+    // the bank to each of the channels, channel c taking pickup c % numPickups
+    void process(const ModalBank &bank, float *const *channels, int numChannels, int numSamples,
+                 float gain, bool accumulate);
+
+    static constexpr int fftOrder = 10;
+    static constexpr int frameSize = 1 << fftOrder;
+    static constexpr int hopSize = frameSize / 4;
+
+private:
+    void start(const ModalBank &bank);
+    void updateCoefficients(const ModalBank &bank);
+    void nextHop(const ModalBank &bank);
+    // Synthesize the frame whose centre is at the bank's phasors, and add
+    // its samples from skip onwards to the start of the overlap buffers
+    void synthesizeFrame(const ModalBank &bank, int skip);
+    // Advance the bank's phasors by one hop
+    void advance(const ModalBank &bank);
+
+    // the main lobe of the window's spectrum, in bins either side of a mode
+    static constexpr int kernelHalfWidth = 4;
+    static constexpr int kernelOversampling = 512;
+    static const float *getKernel();
+
+    const float *const kernel;
+    juce::dsp::FFT fft;
+    const int numPickups;
+
+    // per mode: the complex factor over one hop, its phase alone, and the
+    // mode's frequency in bins
+    float *const hopRe;
+    float *const hopIm;
+    float *const rotRe;
+    float *const rotIm;
+    float *const bins;
+    // for each pickup, the half spectrum for the inverse FFT (2 * frameSize
+    // floats, as juce::dsp::FFT needs), and the output still to be played
+    float *spectrum[ModalBank::maxPickups];
+    float *overlap[ModalBank::maxPickups];
+
+    int hopPosition = hopSize;  // samples of the current hop already played
+    bool needsRestart = false;
+    bool needsCoefficients = false;
+
+    JUCE_DECLARE_NON_COPYABLE (SpectralRenderer)
+};
@@ -9,75 +9,590 @@
 */
 
 #include "StiffString.h"
+#include "FastMath.h"
 
-StiffString::StiffString(LEAF *const leaf, int numModes) :
+StiffString::StiffString(LEAF *const leaf, int numModes, int numPickups, float *storage) :
     leaf(leaf),
-    numModes(numModes)
+    numModes(numModes),
+    numPickups(numPickups),
+    modes(numModes, numPickups, storage),
+    modeNumbers(VoiceArena::createInts(getModeArray(storage, numModes, numPickups, 0), (size_t) numModes)),
+    parkedNumbers(VoiceArena::createInts(getModeArray(storage, numModes, numPickups, 1), (size_t) numModes)),
+    parkedAmplitudes(getModeArray(storage, numModes, numPickups, 2)),
+    parkedTimes(getModeArray(storage, numModes, numPickups, 3)),
+    order(VoiceArena::createInts(getModeArray(storage, numModes, numPickups, 4), (size_t) numModes)),
+    logRe(getModeArray(storage, numModes, numPickups, 5)),
+    logIm(getModeArray(storage, numModes, numPickups, 6)),
+    driveWeights(getModeArray(storage, numModes, numPickups, 7)),
+    modeLimit(numModes)
 {
-    amplitudes = new float[numModes];
-    outputWeights = new float[numModes];
-    osc = new tCycle[numModes];
-    for (int i = 0; i < numModes; ++i) {
-        tCycle_init(&osc[i], leaf);
+    for (int p = 0; p < numPickups; ++p) {
+        outputWeights[p] = getModeArray(storage, numModes, numPickups, 8 + p);
+    }
+    float *next = getModeArray(storage, numModes, numPickups, getNumModeArrays(numPickups));
+    if (numModes >= spectralMinModes) {
+        spectral = std::make_unique<SpectralRenderer>(numModes, numPickups, next);
+        next += SpectralRenderer::getStorageSize(numModes, numPickups);
+    }
+    if (numModes >= multirateMinModes) {
+        multirate = std::make_unique<MultirateRenderer>(numModes, numPickups, next);
     }
-    updateOutputWeights();
+    modes.setNumModes(0);
+    updateOutputWeights(0);
 }
 
 StiffString::~StiffString()
 {
-    delete[] osc;
-    delete[] amplitudes;
-    delete[] outputWeights;
+}
+
+size_t StiffString::getStorageSize(int numModes, int numPickups)
+{
+    // the modal bank, then the per-mode arrays, then the spectral and
+    // multirate renderers' state if there are any
+    return ModalBank::getStorageSize(numModes, numPickups)
+         + (size_t) getNumModeArrays(numPickups) * VoiceArena::roundUp((size_t) numModes)
+         + (numModes >= spectralMinModes ? SpectralRenderer::getStorageSize(numModes, numPickups) : 0)
+         + (numModes >= multirateMinModes ? MultirateRenderer::getStorageSize(numModes, numPickups) : 0);
+}
+
+float *StiffString::getModeArray(float *storage, int numModes, int numPickups, int index)
+{
+    return storage + ModalBank::getStorageSize(numModes, numPickups)
+         + (size_t) index * VoiceArena::roundUp((size_t) numModes);
 }
 
 void StiffString::setFreq(float newFreqHz)
 {
     freqHz = newFreqHz;
-    float kappa_sq = stiffness * stiffness;
-    for (int i = 0; i < numModes; ++i) {
-        int n = i + 1;
-        int n_sq = n * n;
-        float sig = decay + decayHighFreq * n_sq;
-        float w0 = n * sqrtf(1.0f + kappa_sq * n_sq);
-        float zeta = sig / w0;
-        float w = w0 * sqrtf(1.0f - zeta * zeta);
-        tCycle_setFreq(&osc[i], freqHz * w);
+    updateCoefficients();
+}
+
+void StiffString::setFreqRatio(float newRatio)
+{
+    if (newRatio == freqRatio) {
+        return;
+    }
+    freqRatio = newRatio;
+    applyCoefficients();
+}
+
+void StiffString::setParameters(const Parameters &newParams, int rampSamples, const float *const *pickupShapes)
+{
+    const bool coefficientsChanged = newParams.stiffness != params.stiffness
+                                  || newParams.decay != params.decay
+                                  || newParams.decayHighFreq != params.decayHighFreq;
+    const bool pickupChanged = !std::equal(newParams.pickupPos.begin(), newParams.pickupPos.begin() + numPickups,
+                                           params.pickupPos.begin());
+    const bool driveChanged = newParams.pluckPos != params.pluckPos || newParams.stiffness != params.stiffness;
+    params = newParams;
+
+    if (driveChanged) {
+        driveWeightsValid = false;
+    }
+    if (coefficientsChanged) {
+        updateCoefficients();
+    } else if (driveChanged) {
+        updateDrive();
+    }
+    if (pickupChanged) {
+        updateOutputWeights(rampSamples, pickupShapes);
+    }
+}
+
+// The log of mode n's coefficient, logRe + i logIm
+static void getModeLog(const StiffString::Parameters &params, float n, float radPerSample,
+                       float &logRe, float &logIm)
+{
+    // Mode n oscillates at freqHz * w and its amplitude decays at the rate
+    // sig * freqHz, so each sample multiplies it by a complex coefficient
+    // r exp(i omega).
+    const float kappa_sq = params.stiffness * params.stiffness;
+    const float n_sq = n * n;
+    const float sig = params.decay + params.decayHighFreq * n_sq;
+    const float w0 = n * std::sqrt(1.0f + kappa_sq * n_sq);
+    const float zeta = sig / w0;
+    const float w = w0 * std::sqrt(juce::jmax(0.0f, 1.0f - zeta * zeta));
+    logRe = -sig * radPerSample;
+    logIm = w * radPerSample;
+}
+
+bool StiffString::getModeCoefficient(const Parameters &params, int n, float radPerSample,
+                                     float &radius, float &omega)
+{
+    // Modes at or above Nyquist would only alias, so they are dropped.
+    float logRe;
+    getModeLog(params, (float) n, radPerSample, logRe, omega);
+    radius = expf(logRe);
+    return omega < PI;
+}
+
+bool StiffString::getComplexCoefficient(const Parameters &params, int n, float radPerSample,
+                                        float &re, float &im)
+{
+    // as applyCoefficients, with no bend or damper
+    float logRe, logIm;
+    getModeLog(params, (float) n, radPerSample, logRe, logIm);
+    const float radius = FastMath::expNonPositive(logRe);
+    FastMath::unitPhasor(logIm, re, im);
+    re *= radius;
+    im *= radius;
+    return logIm < PI;
+}
+
+void StiffString::updateCoefficients()
+{
+    computeModeLogs();
+    applyCoefficients();
+    updateDrive();
+}
+
+void StiffString::computeModeLogs()
+{
+    // As getModeCoefficient, for all the active modes in one loop
+    const float radPerSample = freqHz * leaf->twoPiTimesInvSampleRate;
+    const int numActive = modes.getNumModes();
+    for (int i = 0; i < numActive; ++i) {
+        getModeLog(params, (float) std::abs(modeNumbers[i]), radPerSample, logRe[i], logIm[i]);
+    }
+    logsValid = true;
+    ++modeTuningVersion;
+}
+
+void StiffString::applyCoefficients()
+{
+    if (!logsValid) {
+        computeModeLogs();
+    }
+    // c = damper * exp(ratio * log c0), with no branches, so the loop
+    // vectorizes.  Only the coefficients change, so the phases carry on.
+    const auto &b = modes.getBuffers();
+    const float logDamper = std::log(damper);
+    const float ratio = freqRatio;
+    const int numActive = modes.getNumModes();
+    for (int i = 0; i < numActive; ++i) {
+        const float radius = FastMath::expNonPositive(ratio * logRe[i] + logDamper);
+        float re, im;
+        FastMath::unitPhasor(ratio * logIm[i], re, im);
+        b.coefRe[i] = radius * re;
+        b.coefIm[i] = radius * im;
+    }
+    // Modes bent up to Nyquist or above are dropped, and stay dropped when
+    // the bend comes back down
+    for (int i = 0; i < modes.getNumModes(); ) {
+        if (ratio * logIm[i] >= PI) {
+            removeMode(i);
+        } else {
+            ++i;
+        }
+    }
+    if (spectral != nullptr) {
+        spectral->coefficientsChanged();
+    }
+    if (multirate != nullptr) {
+        multirate->coefficientsChanged();
+    }
+}
+
+void StiffString::removeMode(int i)
+{
+    const int last = modes.getNumModes() - 1;
+    if (modeNumbers[i] < 0) {
+        --numFading;
+    }
+    modeNumbers[i] = modeNumbers[last];
+    logRe[i] = logRe[last];
+    logIm[i] = logIm[last];
+    if (spectral != nullptr) {
+        spectral->removeMode(i, last);
+    }
+    if (multirate != nullptr) {
+        multirate->removeMode(i, last);
+    }
+    modes.removeMode(i);
+    ++modeRemovalVersion;
+}
+
+void StiffString::removeInaudibleModes()
+{
+    outputBound = 0.0f;
+    for (int i = 0; i < modes.getNumModes(); ) {
+        float amplitude = modes.getAmplitude(i);
+        if (amplitude < audibilityFloor && !driven) {
+            removeMode(i);
+        } else {
+            outputBound += amplitude * getPeakWeight(i);
+            ++i;
+        }
+    }
+}
+
+void StiffString::damp(float factorPerSample)
+{
+    damper = factorPerSample;
+    applyCoefficients();
+}
+
+void StiffString::renderBlock(float *dest, int numSamples)
+{
+    render(&dest, 1, numSamples, 1.0f, false);
+}
+
+void StiffString::addBlock(float *const *dest, int numChannels, int numSamples, float gain, const float *input)
+{
+    render(dest, numChannels, numSamples, gain, true, input);
+}
+
+void StiffString::render(float *const *dest, int numChannels, int numSamples, float gain, bool accumulate,
+                         const float *input)
+{
+    prepareBlock();
+    // a note that started undriven may not take input
+    jassert(input == nullptr || !(useSpectral || useMultirate));
+    if (useSpectral) {
+        spectral->process(modes, dest, numChannels, numSamples, gain, accumulate);
+    } else if (useMultirate) {
+        multirate->process(modes, dest, numChannels, numSamples, gain, accumulate);
+    } else if (accumulate) {
+        modes.addBlock(dest, numChannels, numSamples, gain, input);
+    } else {
+        modes.renderBlock(dest[0], numSamples);
+    }
+    finishBlock(numSamples);
+}
+
+bool StiffString::prepareBlock()
+{
+    if (engineChoicePending) {
+        // the coefficients are set by now, so modes above Nyquist are gone
+        useSpectral = !driven && spectral != nullptr && modes.getNumModes() >= spectralMinModes;
+        useMultirate = !driven && !useSpectral && multirate != nullptr && multirateAllowed
+                    && multirate->isWorthUsing(modes);
+        engineChoicePending = false;
+        if (useSpectral) {
+            modes.startWeightRamp(0);
+        }
+    }
+    applyModeLimit();
+    return !(useSpectral || useMultirate);
+}
+
+void StiffString::finishBlock(int numSamples)
+{
+    samplesSincePluck += numSamples;
+    if (numFading > 0 && !modes.isRamping()) {
+        parkFadedModes();
+    }
+    removeInaudibleModes();
+}
+
+void StiffString::setModeLimit(int newLimit, int fadeSamples)
+{
+    modeLimit = juce::jlimit(1, numModes, newLimit);
+    fadeLength = fadeSamples;
+}
+
+void StiffString::applyModeLimit()
+{
+    // one change at a time: wait for a fade out to finish before starting
+    // another, or bringing modes back
+    if (numFading > 0) {
+        return;
+    }
+    const int numActive = modes.getNumModes();
+    if (numActive > modeLimit) {
+        fadeOutModes(numActive - modeLimit);
+    } else if (numActive < modeLimit && numParked > 0) {
+        restoreModes(modeLimit - numActive);
+    }
+}
+
+void StiffString::fadeOutModes(int count)
+{
+    // Shed the quietest modes at the pickup, favouring high ones, which cost
+    // the same but are heard least
+    const int numActive = modes.getNumModes();
+    for (int i = 0; i < numActive; ++i) {
+        order[i] = i;
+    }
+    auto loudness = [this](int i) {
+        return modes.getAmplitude(i) * getPeakWeight(i) / (float) modeNumbers[i];
+    };
+    std::nth_element(order, order + count, order + numActive,
+                     [&loudness](int a, int b) { return loudness(a) < loudness(b); });
+    for (int k = 0; k < count; ++k) {
+        const int i = order[k];
+        modeNumbers[i] = -modeNumbers[i];
+        setTargetWeights(i, 0);
+    }
+    numFading = count;
+    startWeightRamp(fadeLength);
+}
+
+void StiffString::parkFadedModes()
+{
+    // Keep each faded mode's amplitude, and when it was parked, so that it
+    // can come back at the level it would have decayed to
+    for (int i = 0; i < modes.getNumModes(); ) {
+        if (modeNumbers[i] < 0) {
+            parkedNumbers[numParked] = -modeNumbers[i];
+            parkedAmplitudes[numParked] = modes.getAmplitude(i);
+            parkedTimes[numParked] = (float) samplesSincePluck;
+            ++numParked;
+            removeMode(i);
+        } else {
+            ++i;
+        }
+    }
+    jassert(numFading == 0);
+}
+
+void StiffString::restoreModes(int count)
+{
+    // bring back the modes that would be loudest now
+    const float radPerSample = getRadPerSample();
+    for (int k = 0; k < numParked; ++k) {
+        int n = parkedNumbers[k];
+        float radius, omega;
+        if (getModeCoefficient(params, n, radPerSample, radius, omega)) {
+            float elapsed = (float) samplesSincePluck - parkedTimes[k];
+            parkedAmplitudes[k] *= std::pow(damper * radius, elapsed);
+        } else {
+            parkedAmplitudes[k] = 0.0f;
+        }
+        parkedTimes[k] = (float) samplesSincePluck;
+        order[k] = k;
+    }
+    count = juce::jmin(count, numParked);
+    std::nth_element(order, order + count, order + numParked,
+                     [this](int a, int b) { return parkedAmplitudes[a] > parkedAmplitudes[b]; });
+
+    int numRestored = 0;
+    for (int k = 0; k < count; ++k) {
+        const int j = order[k];
+        const int n = parkedNumbers[j];
+        float radius, omega;
+        if (parkedAmplitudes[j] < audibilityFloor || !getModeCoefficient(params, n, radPerSample, radius, omega)) {
+            continue;
+        }
+        const int i = modes.getNumModes();
+        modes.setNumModes(i + 1);
+        modeNumbers[i] = n;
+        modes.setAmplitude(i, parkedAmplitudes[j]);
+        setModeWeights(i, 0);
+        setTargetWeights(i, n);
+        parkedAmplitudes[j] = -1.0f;  // restored
+        ++numRestored;
+    }
+
+    // drop the restored modes, and any too quiet to come back, from the
+    // parked list
+    for (int k = 0; k < numParked; ) {
+        if (parkedAmplitudes[k] < audibilityFloor) {
+            --numParked;
+            parkedNumbers[k] = parkedNumbers[numParked];
+            parkedAmplitudes[k] = parkedAmplitudes[numParked];
+            parkedTimes[k] = parkedTimes[numParked];
+        } else {
+            ++k;
+        }
+    }
+
+    if (numRestored > 0) {
+        startWeightRamp(fadeLength);
+        // the restored modes have no coefficients yet
+        updateCoefficients();
     }
 }
 
 float StiffString::getNextSample()
 {
-    float sample = 0.0f;
+    if (useSpectral || useMultirate) {
+        float sample;
+        renderBlock(&sample, 1);
+        return sample;
+    }
+    return modes.getNextSample();
+}
+
+void StiffString::getPickupShape(float pickupPos, int numModes, float *dest)
+{
+    float x0 = pickupPos * 0.5 * PI;
     for (int i = 0; i < numModes; ++i) {
-        sample += tCycle_tick(&osc[i]) * amplitudes[i] * outputWeights[i];
-        int n = i + 1;
-        float sig = decay + decayHighFreq * n * n;
-        amplitudes[i] *= exp(-sig * freqHz * leaf->twoPiTimesInvSampleRate);
+        dest[i] = sin((i + 1) * x0);
     }
-    return sample;
 }
 
-void StiffString::setPickupPos(float newValue)
+void StiffString::updateOutputWeights(int rampSamples, const float *const *pickupShapes)
 {
-    pickupPos = newValue;
-    updateOutputWeights();
+    for (int p = 0; p < numPickups; ++p) {
+        if (pickupShapes != nullptr) {
+            std::copy(pickupShapes[p], pickupShapes[p] + numModes, outputWeights[p]);
+        } else {
+            getPickupShape(params.pickupPos[(size_t) p], numModes, outputWeights[p]);
+        }
+    }
+    for (int i = 0; i < modes.getNumModes(); ++i) {
+        setTargetWeights(i, modeNumbers[i]);
+    }
+    startWeightRamp(rampSamples);
 }
 
-void StiffString::updateOutputWeights()
+void StiffString::updateDriveWeights()
 {
-    float x0 = pickupPos * 0.5 * PI;
+    // A force at x0 drives mode n through sin(n x0), and the mode's
+    // displacement answers in proportion to 1 / w_n, the mode's frequency
+    // over the fundamental's
+    const float x0 = params.pluckPos * 0.5f * PI;
+    const float kappa_sq = params.stiffness * params.stiffness;
     for (int i = 0; i < numModes; ++i) {
-        outputWeights[i] = sin((i + 1) * x0);
+        const float n = (float) (i + 1);
+        driveWeights[i] = std::sin(n * x0) / (n * std::sqrt(1.0f + kappa_sq * n * n));
+    }
+    driveWeightsValid = true;
+}
+
+void StiffString::setDriven(bool isDriven)
+{
+    const bool wasDriven = driven;
+    driven = isDriven;
+    if (driven && !wasDriven) {
+        updateDrive();
+    }
+}
+
+void StiffString::updateDrive()
+{
+    // an undriven string's drive is left as it is, and set in full once it
+    // is driven again
+    if (!driven) {
+        return;
+    }
+    if (!driveWeightsValid) {
+        updateDriveWeights();
+    }
+    // Scaled by the unbent fundamental in radians per sample, so that a given
+    // input sounds the same at any sample rate
+    const float radPerSample = freqHz * leaf->twoPiTimesInvSampleRate;
+    for (int i = 0; i < modes.getNumModes(); ++i) {
+        modes.setDrive(i, radPerSample * driveWeights[std::abs(modeNumbers[i]) - 1]);
+    }
+}
+
+void StiffString::startWeightRamp(int numSamples)
+{
+    // the spectral renderer crossfades between frames anyway
+    modes.startWeightRamp(useSpectral ? 0 : numSamples);
+    if (multirate != nullptr) {
+        multirate->weightsChanged();
+    }
+}
+
+void StiffString::setModeWeights(int i, int n)
+{
+    for (int p = 0; p < numPickups; ++p) {
+        modes.setWeight(i, p, n > 0 ? outputWeights[p][n - 1] : 0.0f);
+    }
+}
+
+void StiffString::setTargetWeights(int i, int n)
+{
+    for (int p = 0; p < numPickups; ++p) {
+        modes.setTargetWeight(i, p, n > 0 ? outputWeights[p][n - 1] : 0.0f);
+    }
+}
+
+float StiffString::getPeakWeight(int i) const
+{
+    float peak = 0.0f;
+    for (int p = 0; p < numPickups; ++p) {
+        peak = juce::jmax(peak, std::abs(modes.getWeight(i, p)));
     }
+    return peak;
+}
+
+float StiffString::getPluckAmplitude(float x0, int n)
+{
+    float denom = n * n * x0 * (PI - x0);
+    jassert(denom != 0);
+    return 2.0f * sin(x0 * n) / denom;
+}
+
+float StiffString::getPluckOutputBound(const Parameters &params, int numModes, int numPickups)
+{
+    float x0 = params.pluckPos * 0.5 * PI;
+    float bound = 0.0f;
+    for (int p = 0; p < numPickups; ++p) {
+        float xp = params.pickupPos[(size_t) p] * 0.5 * PI;
+        float pickupBound = 0.0f;
+        for (int n = 1; n <= numModes; ++n) {
+            pickupBound += std::abs(getPluckAmplitude(x0, n) * sin(n * xp));
+        }
+        bound = juce::jmax(bound, pickupBound);
+    }
+    return bound;
 }
 
 void StiffString::setInitialAmplitudes()
 {
-    float x0 = pluckPos * 0.5 * PI;
+    // Rebuild the list of active modes, leaving out any the pluck does not
+    // excite.  Call setFreq afterwards, to set their coefficients.
+    float x0 = params.pluckPos * 0.5 * PI;
+    int numActive = 0;
+    outputBound = 0.0f;
     for (int i = 0; i < numModes; ++i) {
         int n = i + 1;
-        float denom = n * n * x0 * (PI - x0);
-        jassert(denom != 0);
-        amplitudes[i] = 2.0f * sin(x0 * n) / denom;
+        float amplitude = getPluckAmplitude(x0, n);
+        if (std::abs(amplitude) < audibilityFloor) {
+            continue;
+        }
+        modeNumbers[numActive] = n;
+        modes.setAmplitude(numActive, pluckLevel * amplitude);
+        setModeWeights(numActive, n);
+        outputBound += std::abs(pluckLevel * amplitude) * getPeakWeight(numActive);
+        ++numActive;
+    }
+    finishPluck(numActive);
+}
+
+void StiffString::pluck(float newFreqHz, const float *amplitudes, const float *coefRe, const float *coefIm)
+{
+    // As setInitialAmplitudes then setFreq, with the work already done
+    freqHz = newFreqHz;
+    int numActive = 0;
+    outputBound = 0.0f;
+    for (int i = 0; i < numModes; ++i) {
+        if (std::abs(amplitudes[i]) < audibilityFloor || (coefRe[i] == 0.0f && coefIm[i] == 0.0f)) {
+            continue;
+        }
+        modeNumbers[numActive] = i + 1;
+        modes.setAmplitude(numActive, pluckLevel * amplitudes[i]);
+        modes.setComplexCoefficient(numActive, coefRe[i], coefIm[i]);
+        setModeWeights(numActive, i + 1);
+        outputBound += std::abs(pluckLevel * amplitudes[i]) * getPeakWeight(numActive);
+        ++numActive;
+    }
+    finishPluck(numActive);
+    updateDrive();
+    // the tables are for the unbent string
+    if (freqRatio != 1.0f) {
+        applyCoefficients();
+    }
+}
+
+void StiffString::finishPluck(int numActive)
+{
+    modes.setNumModes(numActive);
+    ++modeTuningVersion;
+    damper = 1.0f;
+    logsValid = false;
+    numFading = 0;
+    numParked = 0;
+    samplesSincePluck = 0.0;
+    if (spectral != nullptr) {
+        spectral->restart();
+    }
+    if (multirate != nullptr) {
+        multirate->restart();
     }
+    engineChoicePending = spectral != nullptr || multirate != nullptr;
 }
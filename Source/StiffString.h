@@ -11,38 +11,232 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "ModalBank.h"
+#include "SpectralRenderer.h"
+#include "MultirateRenderer.h"
 
 class StiffString {
 public:
-    StiffString(LEAF *const leaf, int numModes);
+    struct Parameters {
+        float stiffness = 0.0f;
+        float pluckPos = 0.2f;
+        // the position of each pickup; only the first numPickups are used
+        std::array<float, ModalBank::maxPickups> pickupPos { 0.3f, 0.35f, 0.25f, 0.4f, 0.2f, 0.45f, 0.15f, 0.5f };
+        float decay = 0.0f;
+        float decayHighFreq = 0.0f;
+
+        bool operator==(const Parameters &other) const
+        {
+            return stiffness == other.stiffness && pluckPos == other.pluckPos
+                && pickupPos == other.pickupPos && decay == other.decay
+                && decayHighFreq == other.decayHighFreq;
+        }
+        bool operator!=(const Parameters &other) const { return !(*this == other); }
+    };
+
+    // storage must hold getStorageSize(numModes, numPickups) floats, and is
+    // normally this string's slice of a VoiceArena.  Each pickup feeds its
+    // own output channel (see ModalBank::addBlock).
+    StiffString(LEAF *const leaf, int numModes, int numPickups, float *storage);
     ~StiffString();
 
+    static size_t getStorageSize(int numModes, int numPickups);
+
     void setFreq(float newFreqHz);
+    // Bend the string by a frequency ratio, for pitch bend and vibrato.  Every
+    // mode's frequency and decay rate scale with it, as if the fundamental
+    // had changed, but the phases carry on, so the bend can move every few
+    // dozen samples without clicks.  A pluck keeps the current ratio.
+    void setFreqRatio(float newRatio);
     void setInitialAmplitudes();
+    // Pluck at the given frequency, from precomputed tables (see ModalTables):
+    // the pluck amplitude of each mode number from 1, and each mode's
+    // coefficient at this frequency, zero for modes at or above Nyquist.
+    // The tables must match the current parameters.
+    void pluck(float newFreqHz, const float *amplitudes, const float *coefRe, const float *coefIm);
     float getNextSample();
+    void renderBlock(float *dest, int numSamples);
+    // If input is not nullptr, its numSamples samples drive the string (see
+    // setDriven)
+    void addBlock(float *const *dest, int numChannels, int numSamples, float gain,
+                  const float *input = nullptr);
+
+    // Rendering in steps, for a caller that sweeps the modes of many strings
+    // together.  If prepareBlock returns true, the caller advances
+    // getModalBank() by numSamples, then calls finishBlock(numSamples).  If
+    // it returns false, the string renders itself, through addBlock.
+    bool prepareBlock();
+    void finishBlock(int numSamples);
+    ModalBank &getModalBank() { return modes; }
+
+    // modes still sounding: not above Nyquist, and not yet decayed away
+    int getNumActiveModes() const { return modes.getNumModes(); }
+    // Changes whenever modes are added or retuned, so that tables built from
+    // the modes know to rebuild.  Bending the string and damping it change
+    // neither: the modes' frequencies all scale by getFreqRatio().
+    uint32_t getModeTuningVersion() const { return modeTuningVersion; }
+    // changes whenever a mode is removed, when the others may move
+    uint32_t getModeRemovalVersion() const { return modeRemovalVersion; }
+    float getFreqRatio() const { return freqRatio; }
+    // the mode number of active mode i, from 1
+    int getModeNumber(int i) const { return std::abs(modeNumbers[i]); }
+    // whether the note renders itself rather than being swept (see
+    // prepareBlock), once its first block has chosen how
+    bool rendersItself() const { return useSpectral || useMultirate; }
+    const char *getKernelName() const
+    {
+        return useSpectral ? "ifft-ola" : useMultirate ? "multirate" : modes.getKernelName();
+    }
+    // Whether the next note may render its low modes at decimated rates (see
+    // MultirateRenderer).  Those modes run ahead of the output, so a caller
+    // that couples strings through their phasors should forbid it.
+    void setMultirateAllowed(bool allowed) { multirateAllowed = allowed; }
+
+    // Whether an input signal drives the string, as a force applied at the
+    // pluck position.  The input reaches each mode through its shape at that
+    // point, over its frequency, as in ModalBank.  A driven string keeps every
+    // mode however quiet, so that the input can excite it again, and its
+    // next note renders in the time domain, which is the only renderer that
+    // takes input.  The drive is only worked out for a driven string, so
+    // parameter changes cost an undriven one nothing here.
+    void setDriven(bool isDriven);
+    bool isDriven() const { return driven; }
+    // Scale the amplitudes of the next pluck, from 1 down to 0 for a string
+    // that starts at rest and only sounds when driven
+    void setPluckLevel(float level) { pluckLevel = level; }
+
+    // Bound on the magnitude of any pickup's output, from the current mode
+    // amplitudes.  Updated after each rendered block.
+    float getOutputBound() const { return outputBound; }
+    // Bound on the output just after a pluck, for the given parameters
+    static float getPluckOutputBound(const Parameters &params, int numModes, int numPickups);
 
-    // change parameters
-    void setStiffness(float newValue) { stiffness = newValue; }
-    void setPickupPos(float newValue);
-    void setPluckPos(float newValue) { pluckPos = newValue; }
-    void setDecay(float newValue) { decay = newValue; }
-    void setDecayHighFreq(float newValue) { decayHighFreq = newValue; }
+    const Parameters &getParameters() const { return params; }
+
+    // Amplitude of mode n (from 1) for a pluck at x0 (in radians, along a
+    // string of length pi)
+    static float getPluckAmplitude(float x0, int n);
+    // The weight of each mode number, from 1 to numModes, at a pickup
+    static void getPickupShape(float pickupPos, int numModes, float *dest);
+    // Decay per sample and phase increment of mode n, for a fundamental of
+    // radPerSample radians per sample, without the damper.  Returns false if
+    // the mode is at or above Nyquist.
+    static bool getModeCoefficient(const Parameters &params, int n, float radPerSample,
+                                   float &radius, float &omega);
+    // The same mode's complex coefficient, worked out exactly as the string
+    // works out its own, so that a note plucked from tables (see pluck)
+    // plays the same samples as one that is not
+    static bool getComplexCoefficient(const Parameters &params, int n, float radPerSample,
+                                      float &re, float &im);
+
+    // Apply an extra decay factor per sample to every mode, as a damper
+    // does.  The next pluck lifts the damper.
+    void damp(float factorPerSample);
+
+    // Limit the number of modes rendered, for when the CPU is short of time.
+    // Beyond the limit, the quietest modes are faded out over fadeSamples
+    // samples and parked; when the limit rises again, the parked modes that
+    // would be loudest fade back in, at the level they would have decayed
+    // to.  A pluck starts with every mode, then applies the limit.
+    void setModeLimit(int newLimit, int fadeSamples);
+
+    // Change parameters.  Only the coefficients that depend on changed
+    // parameters are recomputed, and new pickup weights are ramped in over
+    // rampSamples samples.  If pickupShapes is not nullptr, it gives the
+    // shape of each pickup for the new parameters (see getPickupShape), to
+    // copy rather than compute.
+    void setParameters(const Parameters &newParams, int rampSamples, const float *const *pickupShapes = nullptr);
 
 private:
-    void updateOutputWeights();
+    void updateOutputWeights(int rampSamples, const float *const *pickupShapes = nullptr);
+    // The weight through which the input drives each mode number, and of
+    // each active mode
+    void updateDriveWeights();
+    void updateDrive();
+    // Set mode i's weights for mode number n, at once or as the targets of a
+    // ramp; n <= 0 silences it
+    void setModeWeights(int i, int n);
+    void setTargetWeights(int i, int n);
+    // Ramp the weights to their targets, at once for the spectral renderer
+    void startWeightRamp(int numSamples);
+    // the largest weight of mode i at any pickup
+    float getPeakWeight(int i) const;
+    void updateCoefficients();
+    // The log of each mode's coefficient, at the unbent frequency and
+    // without the damper, so that bending and damping only need an exp
+    void computeModeLogs();
+    // Set the coefficients from the logs, scaled by the bend, with the damper
+    void applyCoefficients();
+    float getRadPerSample() const { return freqHz * freqRatio * leaf->twoPiTimesInvSampleRate; }
+    void removeMode(int i);
+    void removeInaudibleModes();
+    void render(float *const *dest, int numChannels, int numSamples, float gain, bool accumulate,
+                const float *input = nullptr);
+    void finishPluck(int numActive);
+    void applyModeLimit();
+    void fadeOutModes(int count);
+    void parkFadedModes();
+    void restoreModes(int count);
+    static float *getModeArray(float *storage, int numModes, int numPickups, int index);
+    // the per-mode arrays below, with outputWeights last
+    static int getNumModeArrays(int numPickups) { return 8 + numPickups; }
+
+    // amplitude below which a mode is dropped (-120 dB)
+    static constexpr float audibilityFloor = 1.0e-6f;
+    // Strings with at least this many modes can render by inverse FFT, and
+    // do so for any note that starts with at least this many active modes.
+    // Below it, the time-domain kernels are faster.
+    static constexpr int spectralMinModes = 256;
+    // Strings with at least this many modes can render their low modes at
+    // decimated rates, and do so for any note where that saves enough
+    static constexpr int multirateMinModes = 32;
 
     LEAF *const leaf;
     const int numModes;
+    const int numPickups;
+
+    // the active modes are compacted at the start of the bank, and
+    // modeNumbers gives the mode number n (from 1) of each of them, negated
+    // while the mode fades out to be parked
+    ModalBank modes;
+    int *const modeNumbers;
+
+    // modes shed by the mode limit: their numbers, and their amplitudes at
+    // the time given, in samples since the pluck
+    int *const parkedNumbers;
+    float *const parkedAmplitudes;
+    float *const parkedTimes;
+    int *const order;  // scratch, for ranking modes
+    // the log of each active mode's coefficient, kept alongside the bank
+    float *const logRe;
+    float *const logIm;
+    // the drive weight of each mode number, at unit frequency, worked out
+    // when the string is next driven after the pluck position or stiffness
+    // changes
+    float *const driveWeights;
+    bool driveWeightsValid = false;
+    // the weight of each mode number at each pickup
+    float *outputWeights[ModalBank::maxPickups];
+    int numParked = 0;
+    int numFading = 0;
+    int modeLimit;
+    int fadeLength = 0;
+    double samplesSincePluck = 0.0;
 
-    tCycle *osc;
-    float *amplitudes;
-    float *outputWeights;
-    float freqHz;
-
-    // parameters
-    float stiffness = 0.0f;
-    float pluckPos = 0.2f;
-    float pickupPos = 0.3f;
-    float decay = 0.0f;
-    float decayHighFreq = 0.0f;
+    std::unique_ptr<SpectralRenderer> spectral;
+    bool useSpectral = false;
+    std::unique_ptr<MultirateRenderer> multirate;
+    bool useMultirate = false;
+    bool multirateAllowed = true;
+    bool driven = false;
+    float pluckLevel = 1.0f;
+    bool engineChoicePending = false;
+    float freqHz = 0.0f;
+    float freqRatio = 1.0f;
+    bool logsValid = false;
+    float damper = 1.0f;
+    float outputBound = 0.0f;
+    uint32_t modeTuningVersion = 0;
+    uint32_t modeRemovalVersion = 0;
+    Parameters params;
 };
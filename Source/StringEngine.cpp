@@ -0,0 +1,669 @@
+/*
+  ==============================================================================
+
+    StringEngine.cpp
+    Created: 17 Oct 2026 5:03:58am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#include "StringEngine.h"
+#include "RealtimeWatchdog.h"
+
+StringEngine::StringEngine()
+{
+    std::fill(std::begin(lastPitchWheelValues), std::end(lastPitchWheelValues), 8192);
+}
+
+void StringEngine::setCurrentPlaybackSampleRate(double newRate)
+{
+    if (newRate == sampleRate) {
+        return;
+    }
+    const juce::SpinLock::ScopedLockType sl(lock);
+    allNotesOff(0, false);
+    sampleRate = newRate;
+    for (auto &voice : voices) {
+        voice->setCurrentPlaybackSampleRate(newRate);
+    }
+}
+
+void StringEngine::prepare(int maximumBlockSize, int numOutputChannels, int numWorkers)
+{
+    for (auto &voice : voices) {
+        voice->prepareToPlay(sampleRate, maximumBlockSize, numOutputChannels);
+    }
+    maxBlockSize = maximumBlockSize;
+    if (numWorkers != pool.getNumWorkers()) {
+        pool.start(numWorkers);
+    }
+    jobStarts.resize((size_t) pool.getNumWorkers() + 2);
+    jobBuffers.setSize(getNumJobChannels(getNumVoices(), numPickups), maximumBlockSize);
+    outputChannels.resize((size_t) juce::jmax(1, numOutputChannels));
+}
+
+int StringEngine::getNumJobChannels(int numVoices, int numPickups) const
+{
+    return (pool.getNumWorkers() + 1 + numVoices) * numPickups;
+}
+
+int StringEngine::getNumChannelsToRender(const juce::AudioBuffer<float> &outputAudio) const
+{
+    return juce::jmin(outputAudio.getNumChannels(), (int) outputChannels.size());
+}
+
+void StringEngine::release()
+{
+    pool.stop();
+}
+
+void StringEngine::setVoices(VoiceList &newVoices, std::unique_ptr<VoiceArena> &newArena)
+{
+    const int numVoices = (int) newVoices.size();
+    const int newNumPickups = numVoices > 0 ? newVoices.front()->getModalBank().getNumPickups() : 1;
+    std::vector<ModalBank::Span> newSpans;
+    std::vector<SynthVoice *> newSweptVoices, newSelfRenderedVoices;
+    newSpans.reserve((size_t) numVoices);
+    newSweptVoices.reserve((size_t) numVoices);
+    newSelfRenderedVoices.reserve((size_t) numVoices);
+    juce::AudioBuffer<float> newJobBuffers(getNumJobChannels(numVoices, newNumPickups), maxBlockSize);
+    auto newCoupling = numVoices > 0
+        ? std::make_unique<SympatheticCoupling>(numVoices, newVoices.front()->getModalBank().getMaxModes())
+        : nullptr;
+    for (auto &voice : newVoices) {
+        voice->setCurrentPlaybackSampleRate(sampleRate);
+    }
+
+    const juce::SpinLock::ScopedLockType sl(lock);
+    voices.swap(newVoices);
+    arena.swap(newArena);
+    spans.swap(newSpans);
+    sweptVoices.swap(newSweptVoices);
+    selfRenderedVoices.swap(newSelfRenderedVoices);
+    std::swap(jobBuffers, newJobBuffers);
+    numPickups = newNumPickups;
+    coupling.swap(newCoupling);
+    // the new voices were made with the parameters of their time, so they
+    // are given the latest at the next block
+    voicesReplaced = true;
+}
+
+void StringEngine::setVoiceParameters(const StiffString::Parameters &newParameters, int rampSamples)
+{
+    voiceParameters = newParameters;
+    parameterRampSamples = rampSamples;
+    parametersChanged = true;
+    hasVoiceParameters = true;
+}
+
+void StringEngine::updateVoices(int numSamples)
+{
+    parametersChanged = parametersChanged || (voicesReplaced && hasVoiceParameters);
+    voicesReplaced = false;
+    if (parametersChanged && !voices.empty()) {
+        const auto *table = tables != nullptr ? tables->getCurrent() : nullptr;
+        const int numModes = voices.front()->getModalBank().getMaxModes();
+        const float *const *shapes = table != nullptr
+            ? table->getPickupShapes(voiceParameters, numPickups, numModes)
+            : nullptr;
+        // The voices are all at the same parameters.  Until the shapes turn
+        // up, they keep the pickups they have.
+        auto params = voiceParameters;
+        const auto &current = voices.front()->getParameters();
+        const bool pickupsMoved = !std::equal(params.pickupPos.begin(), params.pickupPos.begin() + numPickups,
+                                              current.pickupPos.begin());
+        const bool waiting = pickupsMoved && shapes == nullptr && tables != nullptr
+                          && pickupWaitSamples < maxPickupWaitSeconds * sampleRate;
+        if (waiting) {
+            params.pickupPos = current.pickupPos;
+            pickupWaitSamples += numSamples;
+        } else {
+            pickupWaitSamples = 0;
+        }
+        for (auto &voice : voices) {
+            voice->setParameters(params, parameterRampSamples, shapes);
+        }
+        parametersChanged = waiting;
+    }
+    for (auto &voice : voices) {
+        voice->setModeLimit(modeLimit);
+    }
+}
+
+void StringEngine::updateActivity()
+{
+    activity = {};
+    for (auto &voice : voices) {
+        if (!voice->isVoiceActive()) {
+            continue;
+        }
+        const int note = voice->getCurrentlyPlayingNote();
+        activity.lowestNote = activity.numVoices == 0 ? note : juce::jmin(activity.lowestNote, note);
+        activity.highestNote = juce::jmax(activity.highestNote, note);
+        ++activity.numVoices;
+        activity.numModes += voice->getNumActiveModes();
+    }
+}
+
+void StringEngine::renderNextBlock(juce::AudioBuffer<float> &outputAudio, const juce::MidiBuffer &midiData,
+                                   int startSample, int numSamples, const float *excitation)
+{
+    // must set the sample rate before using this!
+    jassert(sampleRate != 0.0);
+    const juce::SpinLock::ScopedTryLockType sl(lock);
+    if (!sl.isLocked()) {
+        for (const auto metadata : midiData) {
+            updateChannelState(metadata.getMessage());
+        }
+        return;
+    }
+    updateVoices(numSamples);
+    excitationInput = excitation;
+    blockOutput = &outputAudio;
+    numControlEvents = 0;
+    for (auto &voice : voices) {
+        voice->setRenderedTo(startSample);
+        voice->setNextControlEvent(0);
+    }
+    if (resonance > 0.0f && coupling != nullptr) {
+        coupleVoices(numSamples);
+    }
+
+    // The events are handled in order, each catching up only the voices it
+    // changes, and then every voice is brought to the end of the block
+    const int end = startSample + numSamples;
+    for (const auto metadata : midiData) {
+        eventPosition = juce::jlimit(startSample, end, metadata.samplePosition);
+        handleMidiEvent(metadata.getMessage());
+    }
+    eventPosition = end;
+    renderTo(end);
+    // and those at the very end reach the voices before the list is cleared
+    applyControlEvents(end);
+    blockOutput = nullptr;
+    updateActivity();
+}
+
+bool StringEngine::isToRender(const SynthVoice &voice) const
+{
+    return voice.isVoiceActive() && (!catchingUp || voice.isCatchingUp());
+}
+
+void StringEngine::renderTo(int position)
+{
+    for (;;) {
+        int from = position;
+        for (auto &voice : voices) {
+            if (isToRender(*voice)) {
+                from = juce::jmin(from, voice->getRenderedTo());
+            }
+        }
+        if (from >= position) {
+            return;
+        }
+        // voices left further on join the pass as it reaches them
+        renderModulated(*blockOutput, from, position - from);
+    }
+}
+
+template <typename Predicate>
+void StringEngine::catchUp(Predicate touches)
+{
+    // outside renderNextBlock, there is nothing to catch up
+    if (blockOutput == nullptr) {
+        return;
+    }
+    bool anyBehind = false;
+    for (auto &voice : voices) {
+        const bool behind = voice->isVoiceActive() && voice->getRenderedTo() < eventPosition && touches(*voice);
+        voice->setCatchingUp(behind);
+        anyBehind = anyBehind || behind;
+    }
+    if (anyBehind) {
+        catchingUp = true;
+        renderTo(eventPosition);
+        catchingUp = false;
+    }
+}
+
+void StringEngine::addControlEvent(int channel, int controller, int value)
+{
+    const ControlEvent event { eventPosition, channel, controller, value };
+    if (blockOutput != nullptr && numControlEvents < maxControlEvents) {
+        controlEvents[(size_t) numControlEvents++] = event;
+        return;
+    }
+    for (auto &voice : voices) {
+        applyControlEvent(*voice, event);
+    }
+}
+
+void StringEngine::applyControlEvent(SynthVoice &voice, const ControlEvent &event)
+{
+    if (!voice.isPlayingChannel(event.channel)) {
+        return;
+    }
+    if (event.controller == pitchWheel) {
+        voice.pitchWheelMoved(event.value);
+    } else {
+        voice.controllerMoved(event.controller, event.value);
+    }
+}
+
+void StringEngine::applyControlEvents(int startSample)
+{
+    for (auto &voice : voices) {
+        if (!isToRender(*voice, startSample)) {
+            continue;
+        }
+        int next = voice->getNextControlEvent();
+        for (; next < numControlEvents && controlEvents[(size_t) next].position <= startSample; ++next) {
+            applyControlEvent(*voice, controlEvents[(size_t) next]);
+        }
+        voice->setNextControlEvent(next);
+    }
+}
+
+void StringEngine::coupleVoices(int numSamples)
+{
+    sweptVoices.clear();
+    for (auto &voice : voices) {
+        if (voice->isVoiceActive() && !voice->rendersItself()) {
+            sweptVoices.push_back(voice.get());
+        }
+    }
+    coupling->apply(sweptVoices.data(), (int) sweptVoices.size(), numSamples, sampleRate, resonance);
+}
+
+void StringEngine::renderModulated(juce::AudioBuffer<float> &outputAudio, int startSample, int numSamples)
+{
+    while (numSamples > 0) {
+        applyControlEvents(startSample);
+        const int n = needsControlSteps(startSample, numSamples) ? juce::jmin(numSamples, controlInterval)
+                                                                  : numSamples;
+        renderVoices(outputAudio, startSample, n);
+        startSample += n;
+        numSamples -= n;
+    }
+}
+
+bool StringEngine::needsControlSteps(int startSample, int numSamples) const
+{
+    for (auto &voice : voices) {
+        if (!isToRender(*voice, startSample)) {
+            continue;
+        }
+        const int next = voice->getNextControlEvent();
+        if (voice->isModulating()
+            || (next < numControlEvents && controlEvents[(size_t) next].position < startSample + numSamples)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void StringEngine::handleMidiEvent(const juce::MidiMessage &m)
+{
+    const int channel = m.getChannel();
+    if (m.isNoteOn()) {
+        noteOn(channel, m.getNoteNumber(), m.getFloatVelocity());
+    } else if (m.isNoteOff()) {
+        noteOff(channel, m.getNoteNumber(), m.getFloatVelocity());
+    } else if (m.isAllNotesOff() || m.isAllSoundOff()) {
+        allNotesOff(channel, true);
+    } else if (m.isSustainPedalOn() || m.isSustainPedalOff()) {
+        handleSustainPedal(channel, m.isSustainPedalOn());
+    } else if (m.isSostenutoPedalOn() || m.isSostenutoPedalOff()) {
+        handleSostenutoPedal(channel, m.isSostenutoPedalOn());
+    } else if (m.isPitchWheel()) {
+        handlePitchWheel(channel, m.getPitchWheelValue());
+    } else if (m.isController()) {
+        handleController(channel, m.getControllerNumber(), m.getControllerValue());
+    }
+}
+
+void StringEngine::updateChannelState(const juce::MidiMessage &m)
+{
+    const int channel = m.getChannel();
+    if (m.isSustainPedalOn() || m.isSustainPedalOff()) {
+        sustainPedalsDown[channel] = m.isSustainPedalOn();
+    } else if (m.isPitchWheel()) {
+        lastPitchWheelValues[channel] = m.getPitchWheelValue();
+    } else if (m.isController() && m.getControllerNumber() == 1) {
+        lastModWheelValues[channel] = m.getControllerValue();
+    }
+}
+
+void StringEngine::noteOn(int midiChannel, int midiNoteNumber, float velocity)
+{
+    // a repeated note starts a new voice, and lets the old one ring on
+    auto isPlayingNote = [=](const SynthVoice &v) {
+        return v.getCurrentlyPlayingNote() == midiNoteNumber && v.isPlayingChannel(midiChannel);
+    };
+    catchUp(isPlayingNote);
+    for (auto &voice : voices) {
+        if (isPlayingNote(*voice)) {
+            voice->stopNote(1.0f, true);
+        }
+    }
+    if (auto *voice = findFreeVoice(midiNoteNumber)) {
+        startVoice(*voice, midiChannel, midiNoteNumber, velocity);
+    }
+}
+
+void StringEngine::startVoice(SynthVoice &voice, int midiChannel, int midiNoteNumber, float velocity)
+{
+    // the note starts at the event, and the channel's controllers are as
+    // they stand there
+    catchUp([&voice](const SynthVoice &v) { return &v == &voice; });
+    voice.setRenderedTo(eventPosition);
+    voice.setNextControlEvent(numControlEvents);
+    if (voice.isVoiceActive()) {
+        voice.stopNote(0.0f, false);
+    }
+    voice.setKeyDown(true);
+    voice.setSostenutoPedalDown(false);
+    voice.setSustainPedalDown(sustainPedalsDown[midiChannel]);
+    voice.pitchWheelMoved(lastPitchWheelValues[midiChannel]);
+    voice.controllerMoved(1, lastModWheelValues[midiChannel]);
+    voice.setPluckLevel(pluckLevel);
+    voice.startNote(midiChannel, midiNoteNumber, velocity, ++lastNoteOnCounter);
+}
+
+void StringEngine::noteOff(int midiChannel, int midiNoteNumber, float velocity)
+{
+    catchUp([=](const SynthVoice &v) {
+        return v.getCurrentlyPlayingNote() == midiNoteNumber && v.isPlayingChannel(midiChannel);
+    });
+    for (auto &voice : voices) {
+        if (voice->getCurrentlyPlayingNote() == midiNoteNumber && voice->isPlayingChannel(midiChannel)) {
+            voice->setKeyDown(false);
+            if (!(voice->isSustainPedalDown() || voice->isSostenutoPedalDown())) {
+                voice->stopNote(velocity, true);
+            }
+        }
+    }
+}
+
+void StringEngine::allNotesOff(int midiChannel, bool allowTailOff)
+{
+    catchUp([=](const SynthVoice &v) { return midiChannel <= 0 || v.isPlayingChannel(midiChannel); });
+    for (auto &voice : voices) {
+        if (midiChannel <= 0 || voice->isPlayingChannel(midiChannel)) {
+            voice->stopNote(1.0f, allowTailOff);
+        }
+    }
+    std::fill(std::begin(sustainPedalsDown), std::end(sustainPedalsDown), false);
+}
+
+void StringEngine::handleSustainPedal(int midiChannel, bool isDown)
+{
+    jassert(midiChannel > 0 && midiChannel <= maxMidiChannels);
+    sustainPedalsDown[midiChannel] = isDown;
+    if (!isDown) {
+        catchUp([=](const SynthVoice &v) { return v.isPlayingChannel(midiChannel); });
+    }
+    for (auto &voice : voices) {
+        if (!voice->isPlayingChannel(midiChannel)) {
+            continue;
+        }
+        if (isDown) {
+            if (voice->isKeyDown()) {
+                voice->setSustainPedalDown(true);
+            }
+        } else {
+            voice->setSustainPedalDown(false);
+            if (!(voice->isKeyDown() || voice->isSostenutoPedalDown())) {
+                voice->stopNote(1.0f, true);
+            }
+        }
+    }
+}
+
+void StringEngine::handleSostenutoPedal(int midiChannel, bool isDown)
+{
+    if (!isDown) {
+        catchUp([=](const SynthVoice &v) { return v.isPlayingChannel(midiChannel) && v.isSostenutoPedalDown(); });
+    }
+    for (auto &voice : voices) {
+        if (!voice->isPlayingChannel(midiChannel)) {
+            continue;
+        }
+        if (isDown) {
+            if (voice->isKeyDown()) {
+                voice->setSostenutoPedalDown(true);
+            }
+        } else if (voice->isSostenutoPedalDown()) {
+            voice->setSostenutoPedalDown(false);
+            if (!(voice->isKeyDown() || voice->isSustainPedalDown())) {
+                voice->stopNote(1.0f, true);
+            }
+        }
+    }
+}
+
+void StringEngine::handlePitchWheel(int midiChannel, int wheelValue)
+{
+    jassert(midiChannel > 0 && midiChannel <= maxMidiChannels);
+    lastPitchWheelValues[midiChannel] = wheelValue;
+    addControlEvent(midiChannel, pitchWheel, wheelValue);
+}
+
+void StringEngine::handleController(int midiChannel, int controllerNumber, int controllerValue)
+{
+    jassert(midiChannel > 0 && midiChannel <= maxMidiChannels);
+    if (controllerNumber == 1) {
+        lastModWheelValues[midiChannel] = controllerValue;
+    }
+    addControlEvent(midiChannel, controllerNumber, controllerValue);
+}
+
+SynthVoice *StringEngine::findFreeVoice(int midiNoteNumber) const
+{
+    for (auto &voice : voices) {
+        if (!voice->isVoiceActive()) {
+            return voice.get();
+        }
+    }
+    return findVoiceToSteal(midiNoteNumber);
+}
+
+SynthVoice *StringEngine::findVoiceToSteal(int midiNoteNumber) const
+{
+    // As juce::Synthesiser does: reuse the oldest notes first, but protect
+    // the lowest and highest notes still held, by a key or either pedal,
+    // unless nothing else is left
+    SynthVoice *low = nullptr;
+    SynthVoice *top = nullptr;
+    for (auto &voice : voices) {
+        if (!voice->isPlayingButReleased()) {
+            const int note = voice->getCurrentlyPlayingNote();
+            if (low == nullptr || note < low->getCurrentlyPlayingNote()) {
+                low = voice.get();
+            }
+            if (top == nullptr || note > top->getCurrentlyPlayingNote()) {
+                top = voice.get();
+            }
+        }
+    }
+    // with a single note held, the lowest note takes precedence
+    if (top == low) {
+        top = nullptr;
+    }
+
+    auto oldest = [this](auto &&isCandidate) {
+        SynthVoice *found = nullptr;
+        for (auto &voice : voices) {
+            if (isCandidate(*voice) && (found == nullptr || voice->wasStartedBefore(*found))) {
+                found = voice.get();
+            }
+        }
+        return found;
+    };
+    auto unprotected = [low, top](const SynthVoice &v) { return &v != low && &v != top; };
+
+    if (auto *voice = oldest([=](const SynthVoice &v) { return v.getCurrentlyPlayingNote() == midiNoteNumber; })) {
+        return voice;
+    }
+    if (auto *voice = oldest([=](const SynthVoice &v) { return unprotected(v) && v.isPlayingButReleased(); })) {
+        return voice;
+    }
+    if (auto *voice = oldest([=](const SynthVoice &v) { return unprotected(v) && !v.isKeyDown(); })) {
+        return voice;
+    }
+    if (auto *voice = oldest(unprotected)) {
+        return voice;
+    }
+    return top != nullptr ? top : low;
+}
+
+void StringEngine::renderVoices(juce::AudioBuffer<float> &outputAudio, int startSample, int numSamples)
+{
+    if (voices.empty()) {
+        return;
+    }
+
+    // Gather the voices to render from startSample, and the spans of their
+    // modes in the first voice's arrays
+    const auto &base = voices.front()->getModalBank();
+    blockInput = excitationInput != nullptr ? excitationInput + startSample : nullptr;
+    spans.clear();
+    sweptVoices.clear();
+    selfRenderedVoices.clear();
+    int numSweptModes = 0;
+    for (auto &voice : voices) {
+        if (!isToRender(*voice, startSample)) {
+            continue;
+        }
+        // a note chooses how to render at its first block
+        voice->setMultirateAllowed(resonance == 0.0f);
+        voice->setDriven(blockInput != nullptr);
+        if (voice->prepareBlock(numSamples)) {
+            spans.push_back(voice->getModalBank().getSpan(base));
+            sweptVoices.push_back(voice.get());
+            numSweptModes += spans.back().numModes;
+        } else {
+            selfRenderedVoices.push_back(voice.get());
+        }
+    }
+
+    numSweepJobs = parallel ? juce::jmin(pool.getNumWorkers() + 1, numSweptModes / minModesPerJob) : 0;
+    const bool canRenderInParallel = parallel
+                                  && pool.getNumWorkers() > 0
+                                  && numSamples <= maxBlockSize
+                                  && juce::jmax(1, numSweepJobs) + (int) selfRenderedVoices.size() >= 2
+                                  && jobBuffers.getNumChannels() >= getNumJobChannels(getNumVoices(), numPickups);
+    if (canRenderInParallel) {
+        renderInParallel(outputAudio, startSample, numSamples);
+    } else {
+        // mix straight into the output, at startSample
+        const int numChannels = getNumChannelsToRender(outputAudio);
+        float *const *dest = outputChannels.data();
+        for (int ch = 0; ch < numChannels; ++ch) {
+            outputChannels[(size_t) ch] = outputAudio.getWritePointer(ch, startSample);
+        }
+        if (!sweptVoices.empty()) {
+            sweep(0, (int) sweptVoices.size(),
+                  { dest, numChannels, 0, SynthVoice::noteAmplitude, true, blockInput }, numSamples);
+        }
+        for (auto *voice : selfRenderedVoices) {
+            voice->renderNextBlock(dest, numChannels, numSamples);
+        }
+    }
+
+    // a voice that ended in the block is as far on as the others
+    for (auto *voice : sweptVoices) {
+        voice->setRenderedTo(startSample + numSamples);
+    }
+    for (auto *voice : selfRenderedVoices) {
+        voice->setRenderedTo(startSample + numSamples);
+    }
+}
+
+void StringEngine::sweep(int first, int last, ModalBank::Output out, int numSamples)
+{
+    const auto &buffers = voices.front()->getModalBank().getBuffers();
+    const int blockSize = numSamples;
+    while (numSamples > 0) {
+        // stop at the end of the first weight ramp to finish, so that each
+        // ramp ends on time
+        int n = numSamples;
+        bool ramp = false;
+        for (int k = first; k < last; ++k) {
+            const int remaining = sweptVoices[(size_t) k]->getModalBank().getRampSamplesRemaining();
+            if (remaining > 0) {
+                n = juce::jmin(n, remaining);
+                ramp = true;
+            }
+        }
+        ModalBank::process(buffers, spans.data() + first, last - first, out, n, ramp);
+        if (ramp) {
+            for (int k = first; k < last; ++k) {
+                auto &bank = sweptVoices[(size_t) k]->getModalBank();
+                if (bank.getRampSamplesRemaining() > 0) {
+                    bank.advanceRamp(n);
+                }
+            }
+        }
+        out.offset += n;
+        numSamples -= n;
+    }
+    for (int k = first; k < last; ++k) {
+        sweptVoices[(size_t) k]->finishBlock(blockSize);
+    }
+}
+
+void StringEngine::renderInParallel(juce::AudioBuffer<float> &outputAudio, int startSample, int numSamples)
+{
+    // share the swept voices out between the sweep jobs, by number of modes
+    numSweepJobs = sweptVoices.empty() ? 0 : juce::jmax(1, numSweepJobs);
+    int numSweptModes = 0;
+    for (const auto &span : spans) {
+        numSweptModes += span.numModes;
+    }
+    int k = 0;
+    int modesSoFar = 0;
+    for (int j = 0; j < numSweepJobs; ++j) {
+        jobStarts[(size_t) j] = k;
+        const int target = (int) ((int64_t) numSweptModes * (j + 1) / numSweepJobs);
+        while (k < (int) spans.size() && modesSoFar < target) {
+            modesSoFar += spans[(size_t) k++].numModes;
+        }
+    }
+    jobStarts[(size_t) numSweepJobs] = (int) spans.size();
+
+    numSamplesToRender = numSamples;
+    const int numJobs = numSweepJobs + (int) selfRenderedVoices.size();
+    pool.run(renderJob, this, numJobs);
+
+    const int numChannels = getNumChannelsToRender(outputAudio);
+    for (int j = 0; j < numJobs; ++j) {
+        for (int ch = 0; ch < numChannels; ++ch) {
+            outputAudio.addFrom(ch, startSample, jobBuffers, j * numPickups + ch % numPickups, 0, numSamples);
+        }
+    }
+}
+
+void StringEngine::renderJob(void *context, int index)
+{
+    // the workers render for the audio thread, under the same rules
+    const RealtimeWatchdog::Scope realtimeScope;
+    auto &engine = *static_cast<StringEngine *>(context);
+    const int numPickups = engine.numPickups;
+    float *dest[ModalBank::maxPickups];
+    for (int p = 0; p < numPickups; ++p) {
+        dest[p] = engine.jobBuffers.getWritePointer(index * numPickups + p);
+    }
+    const int n = engine.numSamplesToRender;
+    if (index < engine.numSweepJobs) {
+        const int first = engine.jobStarts[(size_t) index];
+        const int last = engine.jobStarts[(size_t) index + 1];
+        engine.sweep(first, last, { dest, numPickups, 0, SynthVoice::noteAmplitude, false, engine.blockInput }, n);
+    } else {
+        for (int p = 0; p < numPickups; ++p) {
+            juce::FloatVectorOperations::clear(dest[p], n);
+        }
+        engine.selfRenderedVoices[(size_t) (index - engine.numSweepJobs)]->renderNextBlock(dest, numPickups, n);
+    }
+}
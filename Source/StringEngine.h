@@ -0,0 +1,257 @@
+/*
+  ==============================================================================
+
+    StringEngine.h
+    Created: 17 Oct 2026 5:03:58am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SynthVoice.h"
+#include "VoiceArena.h"
+#include "VoiceRenderPool.h"
+#include "SympatheticCoupling.h"
+
+// Plays the voices.  This takes the place of juce::Synthesiser, with the same
+// handling of notes, pedals and voice stealing, but renders the voices
+// together instead of one by one.  The voices' modal banks are laid out alike
+// in one arena, so the modes of every voice rendering in the time domain are
+// advanced in a single sweep, and a few voices with a few modes each fill the
+// SIMD tiles as well as one voice with many.  Voices using the spectral or
+// multirate renderer render on their own.
+//
+// With parallel rendering on, the sweep is split into a job for each core,
+// and each voice rendering on its own is a job of its own.
+//
+// Every voice has the same pickups, and output channel c takes pickup
+// c % numPickups, however the block is rendered.  Only as many channels as
+// prepare was told of are written.
+//
+// MIDI events take effect at their own samples without splitting the block
+// for every voice.  A note-on, note-off or pedal release renders only the
+// voices it changes up to its sample, and the other voices carry on from
+// where they are at the end of the block, swept together.  Voices left at
+// the same sample are rendered together, so a chord starting at one sample
+// is one sweep, however many notes it has.
+//
+// The pitch wheel and mod wheel of each channel reach the voices playing on
+// it, and the voices it starts later.  While any voice's pitch is moving, the
+// engine renders in steps of at most controlInterval samples, and each voice
+// updates its coefficients at every step.  Controller events are listed for
+// the block, and each voice applies them at its first step at or after
+// them, so however many arrive, they cost no more than a moving pitch.
+//
+// With sympathetic resonance on, the modes of the swept voices are coupled
+// to each other once a block, as they stand at its start (see
+// SympatheticCoupling).  Only sounding strings resonate: there is no bank
+// of open strings, so a note resonates with the other notes playing, and
+// not with idle ones.  Voices rendering by inverse FFT hold their modes at
+// a frame centre rather than the current sample, so they take no part, and
+// notes started while it is on don't use the multirate renderer, whose
+// modes run ahead of the output.
+//
+// An excitation signal, such as a sidechain input, may drive every string
+// (see StiffString::setDriven).  It is fed to the sweep, so driving all the
+// voices costs one multiply-add per mode per sample.  Voices rendering on
+// their own don't take it, so notes started while it is on are swept.
+class StringEngine {
+public:
+    using VoiceList = std::vector<std::unique_ptr<SynthVoice>>;
+
+    StringEngine();
+
+    void setCurrentPlaybackSampleRate(double newRate);
+    double getSampleRate() const { return sampleRate; }
+
+    // Size the scratch buffers, prepare the voices and start the workers.
+    // Call with no voices rendering.
+    void prepare(int maximumBlockSize, int numOutputChannels, int numWorkers);
+    void release();
+
+    // Replace all the voices, and the arena holding their modal state, which
+    // must be laid out alike.  Only the swap itself happens under the lock
+    // the audio thread renders with, and the old voices and arena are handed
+    // back to the caller to be freed.  The audio thread never waits for the
+    // lock: a block that finds it held is left silent (see renderNextBlock).
+    void setVoices(VoiceList &newVoices, std::unique_ptr<VoiceArena> &newArena);
+    int getNumVoices() const { return (int) voices.size(); }
+
+    // The voices are only touched by renderNextBlock, under the lock, so
+    // these reach them at the start of the next block.  The parameters are
+    // ramped to over rampSamples (see StiffString::setParameters).
+    //
+    // Moving a pickup takes a sin per mode for every voice, so new pickup
+    // positions wait until the modal tables have their shapes, and every
+    // voice copies those.  The rest of the parameters take effect at once.
+    // If no tables for the new positions turn up within maxPickupWaitSeconds,
+    // or there are no tables, the voices work the shapes out themselves.
+    void setVoiceParameters(const StiffString::Parameters &newParameters, int rampSamples);
+    // The tables whose pickup shapes the voices take, which must outlive the
+    // engine; their current tables are read at the start of each block
+    void setModalTables(const ModalTables *newTables) { tables = newTables; }
+    // see SynthVoice::setModeLimit
+    void setModeLimit(int limit) { modeLimit = limit; }
+
+    // What was sounding at the end of the last block
+    struct Activity {
+        int numVoices = 0;
+        int numModes = 0;
+        // -1 with no voices sounding
+        int lowestNote = -1;
+        int highestNote = -1;
+    };
+    const Activity &getActivity() const { return activity; }
+
+    void setParallelRendering(bool shouldBeParallel) { parallel = shouldBeParallel; }
+    // 0 (off) to 1
+    void setSympatheticResonance(float amount) { resonance = amount; }
+    // the level of the pluck at each note-on, 0 (at rest) to 1
+    void setPluckLevel(float level) { pluckLevel = level; }
+
+    // Add the next numSamples samples to the buffer from startSample, acting
+    // on each MIDI event at its own sample.  If excitation is not nullptr, it
+    // drives the strings, and is indexed as the buffer.
+    //
+    // If the message thread holds the lock, swapping in new voices or a new
+    // sample rate, this adds nothing rather than wait, as the voices that
+    // would have played are being replaced.  The pedals and wheels of each
+    // channel still follow the block's MIDI, so that none is left stuck.
+    void renderNextBlock(juce::AudioBuffer<float> &outputAudio, const juce::MidiBuffer &midiData,
+                         int startSample, int numSamples, const float *excitation = nullptr);
+
+    // Stop every voice playing on the channel, or on every channel if
+    // midiChannel is zero
+    void allNotesOff(int midiChannel, bool allowTailOff);
+
+private:
+    void handleMidiEvent(const juce::MidiMessage &m);
+    // follow the pedals and wheels without touching the voices
+    void updateChannelState(const juce::MidiMessage &m);
+    void noteOn(int midiChannel, int midiNoteNumber, float velocity);
+    void noteOff(int midiChannel, int midiNoteNumber, float velocity);
+    void handleSustainPedal(int midiChannel, bool isDown);
+    void handleSostenutoPedal(int midiChannel, bool isDown);
+    void handlePitchWheel(int midiChannel, int wheelValue);
+    void handleController(int midiChannel, int controllerNumber, int controllerValue);
+
+    SynthVoice *findFreeVoice(int midiNoteNumber) const;
+    SynthVoice *findVoiceToSteal(int midiNoteNumber) const;
+    void startVoice(SynthVoice &voice, int midiChannel, int midiNoteNumber, float velocity);
+    // pass on the parameters and mode limit set since the last block
+    void updateVoices(int numSamples);
+    void updateActivity();
+
+    // Render every voice still to render up to position, a pass for each
+    // sample the voices were left at, from the earliest
+    void renderTo(int position);
+    // Render the voices that an event is about to change, those for which
+    // touches(voice) is true, up to the event
+    template <typename Predicate>
+    void catchUp(Predicate touches);
+    // whether the voice is to be rendered now: by the pass under way, if it
+    // is catching up, and at startSample
+    bool isToRender(const SynthVoice &voice) const;
+    bool isToRender(const SynthVoice &voice, int startSample) const
+    {
+        return isToRender(voice) && voice.getRenderedTo() == startSample;
+    }
+
+    // Control events: pitch wheel moves, and controllers
+    struct ControlEvent {
+        int position;
+        int channel;
+        int controller;  // pitchWheel for the pitch wheel
+        int value;
+    };
+    static constexpr int pitchWheel = -1;
+    void addControlEvent(int channel, int controller, int value);
+    static void applyControlEvent(SynthVoice &voice, const ControlEvent &event);
+    // Apply the control events up to startSample to the voices rendering
+    // from there
+    void applyControlEvents(int startSample);
+
+    void coupleVoices(int numSamples);
+    // Render the voices at startSample, in steps short enough for any pitch
+    // modulation or control event
+    void renderModulated(juce::AudioBuffer<float> &outputAudio, int startSample, int numSamples);
+    bool needsControlSteps(int startSample, int numSamples) const;
+    void renderVoices(juce::AudioBuffer<float> &outputAudio, int startSample, int numSamples);
+    // Advance the modes of the swept voices [first, last), and finish their
+    // block
+    void sweep(int first, int last, ModalBank::Output out, int numSamples);
+    void renderInParallel(juce::AudioBuffer<float> &outputAudio, int startSample, int numSamples);
+    static void renderJob(void *context, int index);
+    int getNumJobChannels(int numVoices, int numPickups) const;
+    int getNumChannelsToRender(const juce::AudioBuffer<float> &outputAudio) const;
+
+    static constexpr int maxMidiChannels = 16;
+    // don't hand a worker fewer modes than this
+    static constexpr int minModesPerJob = 64;
+    // the longest step between updates of a modulated pitch
+    static constexpr int controlInterval = 32;
+    // room for the control events of one block; any beyond reach the voices
+    // straight away
+    static constexpr int maxControlEvents = 1024;
+    // the longest new pickup positions wait for their shapes
+    static constexpr double maxPickupWaitSeconds = 0.05;
+
+    juce::SpinLock lock;
+    VoiceList voices;
+    std::unique_ptr<VoiceArena> arena;
+    double sampleRate = 0.0;
+    uint32_t lastNoteOnCounter = 0;
+    bool sustainPedalsDown[maxMidiChannels + 1] = {};
+    int lastPitchWheelValues[maxMidiChannels + 1];
+    int lastModWheelValues[maxMidiChannels + 1] = {};
+
+    // The block being rendered, and the sample of the event being handled
+    juce::AudioBuffer<float> *blockOutput = nullptr;
+    int eventPosition = 0;
+    bool catchingUp = false;
+    std::array<ControlEvent, maxControlEvents> controlEvents;
+    int numControlEvents = 0;
+
+    // the voices rendering this block: those swept together, with the span
+    // of each one's modes, and those rendering themselves
+    std::vector<ModalBank::Span> spans;
+    std::vector<SynthVoice *> sweptVoices;
+    std::vector<SynthVoice *> selfRenderedVoices;
+
+    VoiceRenderPool pool;
+    bool parallel = false;
+    float resonance = 0.0f;
+    std::unique_ptr<SympatheticCoupling> coupling;
+    float pluckLevel = 1.0f;
+    StiffString::Parameters voiceParameters;
+    int parameterRampSamples = 0;
+    bool parametersChanged = false;
+    bool hasVoiceParameters = false;
+    // set by setVoices, under the lock
+    bool voicesReplaced = false;
+    const ModalTables *tables = nullptr;
+    // how long the latest pickup positions have waited for their shapes
+    int pickupWaitSamples = 0;
+    int modeLimit = std::numeric_limits<int>::max();
+    Activity activity;
+    // the excitation for this call of renderNextBlock, and for the block
+    // being rendered, from its first sample
+    const float *excitationInput = nullptr;
+    const float *blockInput = nullptr;
+    int maxBlockSize = 0;
+    // the swept voices [jobStarts[j], jobStarts[j + 1]) for sweep job j
+    std::vector<int> jobStarts;
+    int numSweepJobs = 0;
+    // a channel for each pickup for each job
+    juce::AudioBuffer<float> jobBuffers;
+    // the output channels from the sample being rendered, when mixing
+    // straight into them, with room for as many as prepare was told of
+    std::vector<float *> outputChannels;
+    int numPickups = 1;
+    int numSamplesToRender = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (StringEngine)
+};
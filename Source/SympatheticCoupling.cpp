@@ -0,0 +1,193 @@
+/*
+  ==============================================================================
+
+    SympatheticCoupling.cpp
+    Created: 17 Oct 2026 5:35:26am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#include "SympatheticCoupling.h"
+
+SympatheticCoupling::SympatheticCoupling(int maxVoices, int maxModes)
+{
+    const size_t maxTotalModes = (size_t) maxVoices * (size_t) maxModes;
+    modes.reserve(maxTotalModes);
+    order.reserve(maxTotalModes);
+    pairs.reserve(maxTotalModes * maxPartnersPerMode);
+    modeIndices.resize((size_t) maxModes + 1);
+    layouts.reserve((size_t) maxVoices);
+}
+
+void SympatheticCoupling::apply(SynthVoice *const *voices, int numVoices, int numSamples, double sampleRate,
+                                float strength)
+{
+    if (layoutChanged(voices, numVoices, sampleRate)) {
+        rebuild(voices, numVoices, sampleRate);
+    } else {
+        update(voices, numVoices);
+    }
+    if (pairs.empty() || strength <= 0.0f) {
+        return;
+    }
+    if (numSamples != rotationSamples || strength != rotationStrength) {
+        computeRotations(numSamples, strength);
+    }
+
+    for (const auto &pair : pairs) {
+        const auto &a = modes[(size_t) pair.a];
+        const auto &b = modes[(size_t) pair.b];
+        const std::complex<float> za { *a.re, *a.im };
+        const std::complex<float> zb { *b.re, *b.im };
+        const auto newA = pair.cosine * za + pair.mix * zb;
+        const auto newB = pair.cosine * zb - std::conj(pair.mix) * za;
+        *a.re = newA.real();
+        *a.im = newA.imag();
+        *b.re = newB.real();
+        *b.im = newB.imag();
+    }
+}
+
+bool SympatheticCoupling::layoutChanged(SynthVoice *const *voices, int numVoices, double sampleRate) const
+{
+    if (sampleRate != layoutSampleRate || (size_t) numVoices != layouts.size()) {
+        return true;
+    }
+    for (int v = 0; v < numVoices; ++v) {
+        const auto &layout = layouts[(size_t) v];
+        if (voices[v] != layout.voice || voices[v]->getModeTuningVersion() != layout.tuningVersion) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SympatheticCoupling::rebuild(SynthVoice *const *voices, int numVoices, double sampleRate)
+{
+    layouts.clear();
+    modes.clear();
+    for (int v = 0; v < numVoices; ++v) {
+        auto &voice = *voices[v];
+        const float freqRatio = voice.getFreqRatio();
+        const int firstMode = (int) modes.size();
+        const auto &bank = voice.getModalBank();
+        const auto &b = bank.getBuffers();
+        for (int i = 0; i < bank.getNumModes() && modes.size() < modes.capacity(); ++i) {
+            const double omega = std::atan2((double) b.coefIm[i], (double) b.coefRe[i]);
+            modes.push_back({ b.re + i, b.im + i, omega, omega / freqRatio, v, voice.getModeNumber(i) });
+        }
+        layouts.push_back({ &voice, voice.getModeTuningVersion(), voice.getModeRemovalVersion(), freqRatio,
+                            firstMode, (int) modes.size() });
+    }
+    layoutSampleRate = sampleRate;
+    bandwidth = juce::MathConstants<double>::twoPi * bandwidthHz / sampleRate;
+    rotationSamples = 0;
+
+    // Walk up the modes in order of frequency, pairing each with the next
+    // few on other strings that lie within the band
+    order.resize(modes.size());
+    for (size_t i = 0; i < modes.size(); ++i) {
+        order[i] = (int) i;
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return modes[(size_t) a].omega < modes[(size_t) b].omega;
+    });
+    pairs.clear();
+    for (size_t k = 0; k < order.size(); ++k) {
+        const auto &a = modes[(size_t) order[k]];
+        int numPartners = 0;
+        for (size_t l = k + 1; l < order.size() && numPartners < maxPartnersPerMode; ++l) {
+            const auto &b = modes[(size_t) order[l]];
+            if (b.omega - a.omega >= bandwidth) {
+                break;
+            }
+            if (b.voice == a.voice) {
+                continue;
+            }
+            pairs.push_back({ order[k], order[l], 1.0f, {} });
+            ++numPartners;
+        }
+    }
+}
+
+void SympatheticCoupling::update(SynthVoice *const *voices, int numVoices)
+{
+    bool removed = false;
+    bool changed = false;
+    for (int v = 0; v < numVoices; ++v) {
+        auto &layout = layouts[(size_t) v];
+        if (voices[v]->getModeRemovalVersion() != layout.removalVersion) {
+            findModes(*voices[v], v);
+            layout.removalVersion = voices[v]->getModeRemovalVersion();
+            removed = true;
+        }
+        if (voices[v]->getFreqRatio() != layout.freqRatio) {
+            bend(v, voices[v]->getFreqRatio());
+            layout.freqRatio = voices[v]->getFreqRatio();
+            changed = true;
+        }
+    }
+    if (removed) {
+        pairs.erase(std::remove_if(pairs.begin(), pairs.end(), [this](const Pair &pair) {
+            return modes[(size_t) pair.a].re == nullptr || modes[(size_t) pair.b].re == nullptr;
+        }), pairs.end());
+        changed = true;
+    }
+    if (changed) {
+        rotationSamples = 0;
+    }
+}
+
+void SympatheticCoupling::findModes(SynthVoice &voice, int v)
+{
+    // Removing a mode moves the last one into its place, so look each one up
+    // by its mode number
+    const auto &layout = layouts[(size_t) v];
+    for (int m = layout.firstMode; m < layout.endMode; ++m) {
+        modeIndices[(size_t) modes[(size_t) m].number] = -1;
+    }
+    const auto &bank = voice.getModalBank();
+    for (int i = 0; i < bank.getNumModes(); ++i) {
+        modeIndices[(size_t) voice.getModeNumber(i)] = i;
+    }
+    const auto &b = bank.getBuffers();
+    for (int m = layout.firstMode; m < layout.endMode; ++m) {
+        auto &mode = modes[(size_t) m];
+        const int i = modeIndices[(size_t) mode.number];
+        mode.re = i < 0 ? nullptr : b.re + i;
+        mode.im = i < 0 ? nullptr : b.im + i;
+    }
+}
+
+void SympatheticCoupling::bend(int v, float freqRatio)
+{
+    const auto &layout = layouts[(size_t) v];
+    for (int m = layout.firstMode; m < layout.endMode; ++m) {
+        auto &mode = modes[(size_t) m];
+        mode.omega = mode.unbentOmega * freqRatio;
+    }
+}
+
+void SympatheticCoupling::computeRotations(int numSamples, float strength)
+{
+    // Seen from a, b turns by delta = omega_b - omega_a each sample, so its
+    // pull on a over the block is the coupling times the sum of
+    // exp(i delta n), which is N sin(N delta / 2) / (N sin(delta / 2)) at
+    // the phase of the block's middle sample.  The coupling falls from full
+    // to nothing across the bandwidth.
+    const double coupling = (double) strength * maxCoupling;
+    for (auto &pair : pairs) {
+        const double delta = modes[(size_t) pair.b].omega - modes[(size_t) pair.a].omega;
+        const double band = juce::jmax(0.0, 1.0 - std::abs(delta) / bandwidth);
+        const double halfDelta = 0.5 * delta;
+        const double coherence = std::abs(std::sin(halfDelta)) < 1.0e-12
+            ? 1.0 : std::sin(numSamples * halfDelta) / (numSamples * std::sin(halfDelta));
+        const double angle = coupling * band * numSamples * coherence;
+        pair.cosine = (float) std::cos(angle);
+        pair.mix = std::complex<float>(std::polar(std::sin(angle), juce::MathConstants<double>::halfPi
+                                                                   + halfDelta * (numSamples - 1)));
+    }
+    rotationSamples = numSamples;
+    rotationStrength = strength;
+}
@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+    SympatheticCoupling.h
+    Created: 17 Oct 2026 5:35:26am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SynthVoice.h"
+
+// Sympathetic resonance between the sounding strings.  Every string's modes
+// push on the bridge, and the bridge pushes back on every mode, but a mode
+// only responds much to the bridge motion near its own frequency.  So rather
+// than summing the bridge signal and feeding it to every mode, which costs
+// modes squared, each mode is coupled straight to the modes of the other
+// strings within a narrow band of its frequency.  The modes are sorted by
+// frequency to find these pairs whenever a string's modes are added or
+// retuned, so the cost stays close to linear in the total number of modes.
+// In between, the pairs follow the strings: a mode removed takes its pairs
+// with it, and a bend scales the frequencies of the string's modes, so the
+// pairs it had are kept, nearer or further apart.  Pairs bent out of the
+// band stop coupling, and modes bent into it are only paired at the next
+// retune.
+//
+// The coupling acts once per block, on the modes' state at the start of the
+// block.  Each pair exchanges energy as two lossless oscillators do, by a
+// rotation of the pair's state: the angle is the coupling over the block,
+// scaled down by how far the two drift apart in phase across the block, and
+// the phase of the exchange follows their mean drift.  A rotation only
+// moves energy between the strings, so the coupling cannot make them grow,
+// whatever the strength or the block size.
+class SympatheticCoupling {
+public:
+    // Room for up to maxVoices voices of maxModes modes each.  The tables
+    // only grow when rebuilt within that room, so apply does not allocate.
+    SympatheticCoupling(int maxVoices, int maxModes);
+
+    // Couple the modes of the voices over the next numSamples samples, before
+    // they are advanced.  strength runs from 0 (off) to 1.
+    void apply(SynthVoice *const *voices, int numVoices, int numSamples, double sampleRate, float strength);
+
+    int getNumPairs() const { return (int) pairs.size(); }
+
+private:
+    bool layoutChanged(SynthVoice *const *voices, int numVoices, double sampleRate) const;
+    void rebuild(SynthVoice *const *voices, int numVoices, double sampleRate);
+    // follow the modes removed from, and the bends of, the strings since the
+    // tables were built
+    void update(SynthVoice *const *voices, int numVoices);
+    void findModes(SynthVoice &voice, int v);
+    void bend(int v, float freqRatio);
+    void computeRotations(int numSamples, float strength);
+
+    // coupling per sample at full strength
+    static constexpr float maxCoupling = 2.0e-4f;
+    // modes further apart than this do not interact
+    static constexpr double bandwidthHz = 12.0;
+    // the most partners a mode looks for above its own frequency
+    static constexpr int maxPartnersPerMode = 8;
+
+    struct Mode {
+        float *re;  // nullptr once the mode is removed
+        float *im;
+        double omega;  // radians per sample
+        double unbentOmega;
+        int voice;
+        int number;  // see StiffString::getModeNumber
+    };
+    // Over a block, a <- cosine * a + mix * b and b <- cosine * b - conj(mix) * a
+    struct Pair {
+        int a;
+        int b;
+        float cosine;
+        std::complex<float> mix;
+    };
+
+    std::vector<Mode> modes;
+    std::vector<int> order;
+    std::vector<Pair> pairs;
+    // the active mode with each mode number, while finding a voice's modes
+    std::vector<int> modeIndices;
+
+    // what the tables were built from, and followed since, for each voice
+    struct Layout {
+        const SynthVoice *voice;
+        uint32_t tuningVersion;
+        uint32_t removalVersion;
+        float freqRatio;
+        // its modes, [firstMode, endMode)
+        int firstMode;
+        int endMode;
+    };
+    std::vector<Layout> layouts;
+    double layoutSampleRate = 0.0;
+    double bandwidth = 0.0;  // radians per sample
+    // what the rotations were computed for
+    int rotationSamples = 0;
+    float rotationStrength = 0.0f;
+
+    JUCE_DECLARE_NON_COPYABLE (SympatheticCoupling)
+};
@@ -1,11 +0,0 @@
-/*
-  ==============================================================================
-
-    SynthSound.cpp
-    Created: 11 Dec 2023 10:48:34am
-    Author:  Clancy Rowley
-
-  ==============================================================================
-*/
-
-#include "SynthSound.h"
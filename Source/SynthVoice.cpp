@@ -9,66 +9,141 @@
 */
 
 #include "SynthVoice.h"
-#include "SynthSound.h"
 
-SynthVoice::SynthVoice(LEAF *const leaf, int numModes) :
+SynthVoice::SynthVoice(LEAF *const leaf, int numModes, int numPickups, float *storage, const ModalTables *tables) :
     leaf(leaf),
     numModes(numModes),
-    stiffString(leaf, numModes)
+    tables(tables),
+    stiffString(leaf, numModes, numPickups, storage)
 {}
 
-bool SynthVoice::canPlaySound (juce::SynthesiserSound* sound)
-{
-    return dynamic_cast<SynthSound*>(sound) != nullptr;
-}
-
-void SynthVoice::startNote (int midiNoteNumber, float velocity, juce::SynthesiserSound *sound, int currentPitchWheelPosition)
+void SynthVoice::startNote (int midiChannel, int midiNoteNumber, float velocity, uint32_t newNoteOnOrder)
 {
+    currentNote = midiNoteNumber;
+    currentChannel = midiChannel;
+    noteOnOrder = newNoteOnOrder;
     if (!playing) {
-        stiffString.setInitialAmplitudes();
+        // a new note starts at the wheel's bend, and at the start of a
+        // vibrato cycle
+        bend = bendTarget;
+        vibratoPhase = 0.0f;
+        stiffString.setFreqRatio(std::exp2(bend / 12.0f));
         auto cyclesPerSecond = juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber);
-        stiffString.setFreq(cyclesPerSecond);
+        const auto *table = tables != nullptr ? tables->getCurrent() : nullptr;
+        if (table != nullptr && table->matches(stiffString.getParameters(), getSampleRate(), numModes)) {
+            stiffString.pluck(cyclesPerSecond, table->getAmplitudes(),
+                              table->getCoefRe(midiNoteNumber), table->getCoefIm(midiNoteNumber));
+        } else {
+            stiffString.setInitialAmplitudes();
+            stiffString.setFreq(cyclesPerSecond);
+        }
     }
     playing = true;
-    masterAmplitude = 0.7f;
 }
 
 void SynthVoice::stopNote (float velocity, bool allowTailOff)
 {
-    if (playing) {
-        masterAmplitude = 0.0f;
-        playing = false;
+    playing = false;
+    // without a sample rate, as before prepareToPlay, there is no tail to
+    // time, so the note stops at once
+    if (allowTailOff && getSampleRate() > 0.0) {
+        // damp the string, and free the voice once the tail has died away
+        stiffString.damp(std::exp(-1.0f / (releaseTime * (float) getSampleRate())));
+    } else {
+        clearCurrentNote();
     }
 }
 
-void SynthVoice::controllerMoved (int controllerNumber, int newControllerValue) {}
+void SynthVoice::pitchWheelMoved(int newPitchWheelValue)
+{
+    bendTarget = pitchBendRange * (float) (newPitchWheelValue - 8192) / 8192.0f;
+}
 
-void SynthVoice::pitchWheelMoved (int newPitchWheelValue) {}
+void SynthVoice::controllerMoved(int controllerNumber, int newControllerValue)
+{
+    if (controllerNumber == 1) {
+        modWheel = (float) newControllerValue / 127.0f;
+    }
+}
 
-void SynthVoice::prepareToPlay (double sampleRate, int samplesPerBlock, int outputChannels)
+void SynthVoice::updateModulation(int numSamples)
 {
-    // WORK HERE
+    // The bend glides along a one-pole curve, and the string takes its pitch
+    // from the middle of the block: the keyframes are a block apart, and the
+    // coefficients step from one to the next with the phases intact
+    const float sr = (float) getSampleRate();
+    const float halfBlock = 0.5f * (float) numSamples;
+    const float glide = 1.0f - std::exp(-halfBlock / (bendGlideTime * sr));
+    bend += (bendTarget - bend) * glide;
+    float semitones = bend;
+    bend += (bendTarget - bend) * glide;
+    if (std::abs(bendTarget - bend) < 1.0e-4f) {
+        bend = bendTarget;
+    }
+
+    const float phaseStep = juce::MathConstants<float>::twoPi * vibratoHz / sr;
+    if (modWheel > 0.0f) {
+        semitones += vibratoDepth * modWheel * std::sin(vibratoPhase + phaseStep * halfBlock);
+    }
+    vibratoPhase = std::fmod(vibratoPhase + phaseStep * (float) numSamples, juce::MathConstants<float>::twoPi);
 
+    stiffString.setFreqRatio(std::exp2(semitones / 12.0f));
+}
+
+void SynthVoice::clearCurrentNote()
+{
+    currentNote = -1;
+    currentChannel = 0;
+    playing = false;
+    keyDown = sustainPedalDown = sostenutoPedalDown = false;
+}
+
+double SynthVoice::getReleaseTailSeconds(const StiffString::Parameters &params, int numModes, int numPickups)
+{
+    // Once damped, every mode decays at least as fast as exp(-t / releaseTime)
+    float peak = noteAmplitude * StiffString::getPluckOutputBound(params, numModes, numPickups);
+    // written so that a NaN bound gives no tail, rather than a NaN one
+    if (!(peak > silenceThreshold)) {
+        return 0.0;
+    }
+    return releaseTime * std::log(peak / silenceThreshold);
+}
+
+void SynthVoice::prepareToPlay (double newSampleRate, int samplesPerBlock, int outputChannels)
+{
+    // Everything the voice renders with, the spectral and multirate
+    // renderers' state included, is in its slice of the voice arena, sized
+    // when the voice was built, and it renders straight into the caller's
+    // channels, so there is nothing to allocate for any block size
+    juce::ignoreUnused (samplesPerBlock, outputChannels);
+    setCurrentPlaybackSampleRate(newSampleRate);
     prepared = true;
 }
 
-void SynthVoice::renderNextBlock (juce::AudioBuffer< float > &outputBuffer, int startSample, int numSamples)
+void SynthVoice::renderNextBlock (float *const *dest, int numChannels, int numSamples, const float *input)
 {
     jassert (prepared);
 
     if (! isVoiceActive()) return;
 
-    voiceBuffer.setSize(outputBuffer.getNumChannels(), numSamples, false, false, true);
-    voiceBuffer.clear();
+    stiffString.addBlock(dest, numChannels, numSamples, noteAmplitude, input);
+    freeIfSilent();
+}
 
-    for (int s = 0; s < numSamples; ++s) {
-        float val = masterAmplitude * stiffString.getNextSample();
-        for (int ch = 0; ch < outputBuffer.getNumChannels(); ++ch) {
-            voiceBuffer.addSample(ch, s, val);
-        }
-    }
+void SynthVoice::finishBlock(int numSamples)
+{
+    stiffString.finishBlock(numSamples);
+    freeIfSilent();
+}
 
-    for (int ch = 0; ch < outputBuffer.getNumChannels(); ++ch) {
-        outputBuffer.addFrom(ch, startSample, voiceBuffer, ch, 0, numSamples);
+void SynthVoice::freeIfSilent()
+{
+    // free the voice once the string has decayed to silence, whether or not
+    // the key is still held, unless the input may drive it again
+    if (stiffString.isDriven() && playing) {
+        return;
+    }
+    if (noteAmplitude * stiffString.getOutputBound() < silenceThreshold) {
+        clearCurrentNote();
     }
 }
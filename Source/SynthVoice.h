@@ -12,32 +12,160 @@
 
 #include <JuceHeader.h>
 #include "StiffString.h"
+#include "ModalTables.h"
 
-class SynthVoice : public juce::SynthesiserVoice
+// One string, and the state of the note it is playing.  The note state is
+// kept as juce::SynthesiserVoice keeps it, for StringEngine's voice
+// allocation.
+class SynthVoice
 {
 public:
-    SynthVoice(LEAF *const leaf, int numModes);
-    bool canPlaySound (juce::SynthesiserSound* sound) override;
-    void startNote (int midiNoteNumber, float velocity, juce::SynthesiserSound *sound, int currentPitchWheelPosition) override;
-    void stopNote (float velocity, bool allowTailOff) override;
-    void controllerMoved (int controllerNumber, int newControllerValue) override;
-    void pitchWheelMoved (int newPitchWheelValue) override;
+    // tables may be nullptr, in which case every note-on computes its modes
+    SynthVoice(LEAF *const leaf, int numModes, int numPickups, float *storage, const ModalTables *tables);
+    static size_t getStorageSize(int numModes, int numPickups)
+    {
+        return StiffString::getStorageSize(numModes, numPickups);
+    }
+    void setCurrentPlaybackSampleRate(double newRate) { sampleRate = newRate; }
+    double getSampleRate() const { return sampleRate; }
     void prepareToPlay (double sampleRate, int samplesPerBlock, int outputChannels);
-    void renderNextBlock (juce::AudioBuffer< float > &outputBuffer, int startSample, int numSamples) override;
 
-    void setStiffness(float stiffness) { stiffString.setStiffness(stiffness); }
-    void setPluckPos(float pluckPos) { stiffString.setPluckPos(pluckPos); }
-    void setPickupPos(float pickupPos) { stiffString.setPickupPos(pickupPos); }
-    void setDecay(float decay) { stiffString.setDecay(decay); }
-    void setDecayHighFreq(float decayHF) { stiffString.setDecayHighFreq(decayHF); }
+    // noteOnOrder increases with every note started, so the engine can find
+    // the oldest voices
+    void startNote (int midiChannel, int midiNoteNumber, float velocity, uint32_t noteOnOrder);
+    void stopNote (float velocity, bool allowTailOff);
+
+    bool isVoiceActive() const { return currentNote >= 0; }
+    int getCurrentlyPlayingNote() const { return currentNote; }
+    bool isPlayingChannel(int midiChannel) const { return currentChannel == midiChannel; }
+    bool wasStartedBefore(const SynthVoice &other) const { return noteOnOrder < other.noteOnOrder; }
+    bool isKeyDown() const { return keyDown; }
+    void setKeyDown(bool isDown) { keyDown = isDown; }
+    bool isSustainPedalDown() const { return sustainPedalDown; }
+    void setSustainPedalDown(bool isDown) { sustainPedalDown = isDown; }
+    bool isSostenutoPedalDown() const { return sostenutoPedalDown; }
+    void setSostenutoPedalDown(bool isDown) { sostenutoPedalDown = isDown; }
+    // sounding, with nothing holding the note any more
+    bool isPlayingButReleased() const
+    {
+        return isVoiceActive() && !(keyDown || sustainPedalDown || sostenutoPedalDown);
+    }
+
+    // The wheels of the voice's channel.  The pitch wheel bends the string
+    // by up to pitchBendRange semitones, gliding to each new value, and the
+    // mod wheel (controller 1) adds vibrato.
+    void pitchWheelMoved(int newPitchWheelValue);
+    void controllerMoved(int controllerNumber, int newControllerValue);
+    // the pitch is moving, so blocks should be kept short
+    bool isModulating() const { return modWheel > 0.0f || bend != bendTarget; }
+
+    // Start the next block of numSamples samples: the pitch is updated once,
+    // at the middle of the block.  If this returns true, the voice renders
+    // in steps, as StiffString::prepareBlock describes, for an engine that
+    // sweeps many voices' modes together at noteAmplitude.  Otherwise, it
+    // adds its block to each of the channels with renderNextBlock, driven by
+    // the input if there is one.
+    bool prepareBlock(int numSamples)
+    {
+        updateModulation(numSamples);
+        return stiffString.prepareBlock();
+    }
+    void renderNextBlock (float *const *dest, int numChannels, int numSamples, const float *input = nullptr);
+    ModalBank &getModalBank() { return stiffString.getModalBank(); }
+    // whether the note renders itself, once its first block has chosen how
+    bool rendersItself() const { return stiffString.rendersItself(); }
+
+    // The engine's progress through its current block with this voice: the
+    // sample the voice has been rendered up to, the next of the block's
+    // control events for it to apply, and whether an event is waiting for
+    // it to catch up (see StringEngine)
+    int getRenderedTo() const { return renderedTo; }
+    void setRenderedTo(int position) { renderedTo = position; }
+    int getNextControlEvent() const { return nextControlEvent; }
+    void setNextControlEvent(int index) { nextControlEvent = index; }
+    bool isCatchingUp() const { return catchingUp; }
+    void setCatchingUp(bool shouldCatchUp) { catchingUp = shouldCatchUp; }
+    // see StiffString::setMultirateAllowed
+    void setMultirateAllowed(bool allowed) { stiffString.setMultirateAllowed(allowed); }
+    // see StiffString::setDriven.  A driven voice is only freed once its
+    // note has stopped, since the input may yet bring it back.
+    void setDriven(bool isDriven) { stiffString.setDriven(isDriven); }
+    // see StiffString::setPluckLevel
+    void setPluckLevel(float level) { stiffString.setPluckLevel(level); }
+    void finishBlock(int numSamples);
+
+    // Every voice plays at the same level, so that the engine can sum the
+    // modes of all of them in one sweep
+    static constexpr float noteAmplitude = 0.7f;
+    // time constant of the damper applied when a note is released, in seconds
+    static constexpr float releaseTime = 0.02f;
+
+    // Time for a released note to fall below the silence threshold, for the
+    // given parameters
+    static double getReleaseTailSeconds(const StiffString::Parameters &params, int numModes, int numPickups);
+
+    // pickupShapes as in StiffString::setParameters
+    void setParameters(const StiffString::Parameters &params, int rampSamples,
+                       const float *const *pickupShapes = nullptr)
+    {
+        stiffString.setParameters(params, isVoiceActive() ? rampSamples : 0, pickupShapes);
+    }
+    const StiffString::Parameters &getParameters() const { return stiffString.getParameters(); }
+
+    int getNumActiveModes() const { return stiffString.getNumActiveModes(); }
+    // see StiffString::getModeTuningVersion
+    uint32_t getModeTuningVersion() const { return stiffString.getModeTuningVersion(); }
+    uint32_t getModeRemovalVersion() const { return stiffString.getModeRemovalVersion(); }
+    float getFreqRatio() const { return stiffString.getFreqRatio(); }
+    int getModeNumber(int i) const { return stiffString.getModeNumber(i); }
+    void setModeLimit(int limit)
+    {
+        stiffString.setModeLimit(limit, juce::roundToInt(modeFadeTime * getSampleRate()));
+    }
 
 private:
+    void clearCurrentNote();
+    void freeIfSilent();
+    void updateModulation(int numSamples);
+
+    // the voice is freed once its output is bound to stay below this (-100 dB)
+    static constexpr float silenceThreshold = 1.0e-5f;
+    // time over which modes shed or restored by the mode limit fade, in seconds
+    static constexpr float modeFadeTime = 0.005f;
+    // the bend at either end of the pitch wheel, in semitones
+    static constexpr float pitchBendRange = 2.0f;
+    // time constant of the glide to a new pitch wheel value, in seconds
+    static constexpr float bendGlideTime = 0.005f;
+    // vibrato with the mod wheel all the way up: depth in semitones, and rate
+    static constexpr float vibratoDepth = 0.5f;
+    static constexpr float vibratoHz = 5.5f;
+
     LEAF *const leaf;
     const int numModes;
-    juce::AudioBuffer<float> voiceBuffer;
+    const ModalTables *const tables;
+    double sampleRate = 0.0;
     bool prepared = false;
     bool playing = false;
 
-    float masterAmplitude = 0.0f;
+    int currentNote = -1;
+    int currentChannel = 0;
+    uint32_t noteOnOrder = 0;
+    bool keyDown = false;
+    bool sustainPedalDown = false;
+    bool sostenutoPedalDown = false;
+
+    int renderedTo = 0;
+    int nextControlEvent = 0;
+    bool catchingUp = false;
+
+    // bend in semitones, and where it is gliding to
+    float bend = 0.0f;
+    float bendTarget = 0.0f;
+    // mod wheel from 0 to 1, and the vibrato's phase in radians
+    float modWheel = 0.0f;
+    float vibratoPhase = 0.0f;
+
     StiffString stiffString;
+
+    JUCE_DECLARE_NON_COPYABLE (SynthVoice)
 };
@@ -0,0 +1,28 @@
+/*
+  ==============================================================================
+
+    VoiceArena.cpp
+    Created: 17 Oct 2026 4:34:40am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#include "VoiceArena.h"
+
+VoiceArena::VoiceArena(int numVoices, size_t floatsPerVoice) :
+    numVoices(numVoices),
+    stride(roundUp(floatsPerVoice))
+{
+    jassert(numVoices > 0);
+    memory.calloc(stride * (size_t) numVoices * sizeof(float) + cacheLineSize);
+    auto address = reinterpret_cast<uintptr_t>(memory.get());
+    auto aligned = (address + cacheLineSize - 1) & ~(uintptr_t) (cacheLineSize - 1);
+    base = reinterpret_cast<float *>(aligned);
+}
+
+float *VoiceArena::getVoiceStorage(int voice) const
+{
+    jassert(voice >= 0 && voice < numVoices);
+    return base + stride * (size_t) voice;
+}
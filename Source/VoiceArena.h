@@ -0,0 +1,53 @@
+/*
+  ==============================================================================
+
+    VoiceArena.h
+    Created: 17 Oct 2026 4:34:40am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// A single zeroed, cache-aligned block of memory holding the modal state of
+// every voice, so that rendering all the voices walks one contiguous region
+// instead of many scattered heap blocks.
+class VoiceArena {
+public:
+    VoiceArena(int numVoices, size_t floatsPerVoice);
+
+    int getNumVoices() const { return numVoices; }
+    float *getVoiceStorage(int voice) const;
+
+    // Round a number of floats up to a whole number of cache lines
+    static size_t roundUp(size_t numFloats)
+    {
+        return (numFloats + floatsPerCacheLine - 1) / floatsPerCacheLine * floatsPerCacheLine;
+    }
+
+    // Make room for count ints in storage handed out as floats, with a
+    // float's size and alignment, starting their lifetime there so that
+    // they are reached as ints rather than through a cast float pointer.
+    // The ints start at zero.
+    static int *createInts(float *storage, size_t count)
+    {
+        static_assert(sizeof(int) == sizeof(float) && alignof(int) <= alignof(float),
+                      "ints take the room of the same number of floats");
+        // non-allocating placement new[] adds no overhead
+        return new (storage) int[count]();
+    }
+
+    static constexpr size_t cacheLineSize = 64;
+    static constexpr size_t floatsPerCacheLine = cacheLineSize / sizeof(float);
+
+private:
+    const int numVoices;
+    const size_t stride;
+    juce::HeapBlock<char> memory;
+    float *base;
+
+    JUCE_DECLARE_NON_COPYABLE (VoiceArena)
+};
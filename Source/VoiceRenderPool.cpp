@@ -0,0 +1,126 @@
+/*
+  ==============================================================================
+
+    VoiceRenderPool.cpp
+    Created: 17 Oct 2026 4:32:51am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#include "VoiceRenderPool.h"
+
+#if defined (__x86_64__) || defined (_M_X64) || defined (__i386__)
+ #include <immintrin.h>
+ #define STIFFSTRING_SPIN_PAUSE() _mm_pause()
+#else
+ #define STIFFSTRING_SPIN_PAUSE()
+#endif
+
+VoiceRenderPool::Worker::Worker(VoiceRenderPool &pool) :
+    juce::Thread("Voice render worker"),
+    pool(pool)
+{}
+
+void VoiceRenderPool::Worker::run()
+{
+    pool.workerLoop();
+}
+
+VoiceRenderPool::VoiceRenderPool() {}
+
+VoiceRenderPool::~VoiceRenderPool()
+{
+    stop();
+}
+
+void VoiceRenderPool::start(int numWorkers)
+{
+    stop();
+    exiting = false;
+    for (int i = 0; i < numWorkers; ++i) {
+        workers.push_back(std::make_unique<Worker>(*this));
+        workers.back()->startThread(juce::Thread::Priority::highest);
+    }
+}
+
+void VoiceRenderPool::stop()
+{
+    if (workers.empty()) {
+        return;
+    }
+    exiting = true;
+    // bump the generation so that parked workers wake up and see exiting
+    state.store(pack(getGeneration(state.load()) + 1, 0, 0));
+    state.notify_all();
+    for (auto &worker : workers) {
+        worker->stopThread(-1);
+    }
+    workers.clear();
+}
+
+void VoiceRenderPool::run(Job job, void *context, int numJobs)
+{
+    jassert(numJobs <= 0xffff);
+    if (numJobs <= 0) {
+        return;
+    }
+
+    // The previous batch has finished, so no worker is reading the job or
+    // context, and it is safe to replace them before publishing the batch.
+    currentJob.store(job, std::memory_order_relaxed);
+    currentContext.store(context, std::memory_order_relaxed);
+    jobsRemaining.store(numJobs, std::memory_order_relaxed);
+    const uint32_t generation = getGeneration(state.load(std::memory_order_relaxed)) + 1;
+    state.store(pack(generation, numJobs, 0));
+    if (numParked.load() > 0) {
+        state.notify_all();
+    }
+
+    runJobs(generation);
+
+    while (jobsRemaining.load(std::memory_order_acquire) > 0) {
+        STIFFSTRING_SPIN_PAUSE();
+    }
+}
+
+void VoiceRenderPool::runJobs(uint32_t generation)
+{
+    uint64_t s = state.load(std::memory_order_acquire);
+    for (;;) {
+        if (getGeneration(s) != generation || getNextJob(s) >= getNumJobs(s)) {
+            return;
+        }
+        const uint64_t claimed = s + 1;
+        if (state.compare_exchange_weak(s, claimed, std::memory_order_acq_rel)) {
+            // the batch cannot finish while this job is outstanding, so the
+            // job and context still belong to it
+            currentJob.load(std::memory_order_relaxed)(currentContext.load(std::memory_order_relaxed),
+                                                        getNextJob(s));
+            jobsRemaining.fetch_sub(1, std::memory_order_acq_rel);
+            s = claimed;
+        }
+    }
+}
+
+void VoiceRenderPool::workerLoop()
+{
+    uint32_t lastGeneration = getGeneration(state.load());
+    while (!exiting) {
+        uint64_t s = state.load(std::memory_order_acquire);
+        for (int i = 0; i < spinCount && getGeneration(s) == lastGeneration; ++i) {
+            STIFFSTRING_SPIN_PAUSE();
+            s = state.load(std::memory_order_acquire);
+        }
+        if (getGeneration(s) == lastGeneration) {
+            numParked.fetch_add(1);
+            state.wait(s);
+            numParked.fetch_sub(1);
+            continue;
+        }
+        lastGeneration = getGeneration(s);
+        if (!exiting) {
+            runJobs(lastGeneration);
+        }
+    }
+}
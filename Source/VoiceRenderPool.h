@@ -0,0 +1,71 @@
+/*
+  ==============================================================================
+
+    VoiceRenderPool.h
+    Created: 17 Oct 2026 4:32:51am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// A fixed pool of worker threads that the audio thread can hand a batch of
+// jobs to.  Handing off and collecting a batch takes no locks and allocates
+// nothing: the batch is published through a single atomic word, workers spin
+// for a while waiting for the next batch and then park on that word.
+class VoiceRenderPool {
+public:
+    using Job = void (*)(void *context, int index);
+
+    VoiceRenderPool();
+    ~VoiceRenderPool();
+
+    // Start or stop the workers.  Not to be called from the audio thread.
+    void start(int numWorkers);
+    void stop();
+    int getNumWorkers() const { return (int) workers.size(); }
+
+    // Run job(context, i) for each i in [0, numJobs), on the workers and on
+    // the calling thread, and return once every job has finished.
+    void run(Job job, void *context, int numJobs);
+
+private:
+    class Worker : public juce::Thread {
+    public:
+        explicit Worker(VoiceRenderPool &pool);
+        void run() override;
+
+    private:
+        VoiceRenderPool &pool;
+    };
+
+    // The batch state is packed into one word: a generation count in the top
+    // 32 bits, the number of jobs in the next 16, and the index of the next
+    // job to claim in the bottom 16.
+    static uint64_t pack(uint32_t generation, int numJobs, int nextJob)
+    {
+        return ((uint64_t) generation << 32) | ((uint64_t) numJobs << 16) | (uint64_t) nextJob;
+    }
+    static uint32_t getGeneration(uint64_t s) { return (uint32_t) (s >> 32); }
+    static int getNumJobs(uint64_t s) { return (int) ((s >> 16) & 0xffff); }
+    static int getNextJob(uint64_t s) { return (int) (s & 0xffff); }
+
+    // Claim and run jobs from the given generation until none are left
+    void runJobs(uint32_t generation);
+    void workerLoop();
+
+    static constexpr int spinCount = 4000;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<uint64_t> state { 0 };
+    std::atomic<int> jobsRemaining { 0 };
+    std::atomic<int> numParked { 0 };
+    std::atomic<bool> exiting { false };
+    std::atomic<Job> currentJob { nullptr };
+    std::atomic<void *> currentContext { nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE (VoiceRenderPool)
+};
@@ -0,0 +1,413 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Created: 17 Oct 2026 5:53:02am
+    Author:  Clancy Rowley
+
+    Measures the error of the plugin's fast paths against ReferenceRenderer.
+    The same notes are rendered through StiffStringAudioProcessor and the
+    reference, for each of a set of cases that exercise different paths, and
+    the time-domain and spectral error are reported as JSON alongside the
+    speedup, so that runs from different builds can be diffed.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "ReferenceRenderer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    juce::File midiFile;
+    juce::File outputFile;
+    juce::StringPairArray parameterValues;
+    juce::String caseName;
+    double sampleRate = 48000.0;
+    int blockSize = 512;
+    bool quick = false;
+};
+
+// Settings for the plugin that send the notes down one of its fast paths
+struct Case {
+    juce::String name;
+    juce::StringPairArray settings;
+};
+
+struct Event {
+    juce::int64 sample;
+    juce::MidiMessage message;
+};
+
+juce::Array<Case> makeCases()
+{
+    auto makeCase = [](const char *name, std::initializer_list<std::pair<const char *, const char *>> settings) {
+        Case c { name, {} };
+        for (auto &setting : settings) {
+            c.settings.set(setting.first, setting.second);
+        }
+        return c;
+    };
+    return {
+        // the time-domain kernels
+        makeCase("time-domain", { { "MODES", "64" } }),
+        // many modes above Nyquist, culled at the pluck
+        makeCase("stiff", { { "MODES", "128" }, { "STIFFNESS", "0.5" } }),
+        // enough modes for the inverse FFT renderer
+        makeCase("spectral", { { "MODES", "512" } }),
+        // the sweep split between the worker threads
+        makeCase("parallel", { { "MODES", "128" }, { "PARALLEL", "1" } }),
+    };
+}
+
+// Notes across the range of the keyboard, overlapping, with some chords and
+// a repeated note
+std::vector<Event> makeTestSequence(double sampleRate, bool quick)
+{
+    std::vector<Event> events;
+    auto add = [&](double seconds, const juce::MidiMessage &message) {
+        events.push_back({ (juce::int64) std::llround(seconds * sampleRate), message });
+    };
+    const int numNotes = quick ? 8 : 24;
+    for (int k = 0; k < numNotes; ++k) {
+        const int note = 28 + (k * 17) % 64;
+        const double start = 0.25 * k;
+        add(start, juce::MidiMessage::noteOn(1, note, 1.0f));
+        add(start + 0.6, juce::MidiMessage::noteOff(1, note));
+        if (k % 4 == 3) {
+            add(start, juce::MidiMessage::noteOn(1, note + 4, 1.0f));
+            add(start, juce::MidiMessage::noteOn(1, note + 7, 1.0f));
+            add(start + 1.0, juce::MidiMessage::noteOff(1, note + 4));
+            add(start + 1.0, juce::MidiMessage::noteOff(1, note + 7));
+        }
+    }
+    add(0.1, juce::MidiMessage::noteOn(1, 60, 1.0f));
+    add(0.35, juce::MidiMessage::noteOn(1, 60, 1.0f));
+    add(0.5, juce::MidiMessage::noteOff(1, 60));
+    std::stable_sort(events.begin(), events.end(), [](const Event &a, const Event &b) { return a.sample < b.sample; });
+    return events;
+}
+
+bool loadMidiFile(const juce::File &file, double sampleRate, std::vector<Event> &events)
+{
+    juce::FileInputStream stream(file);
+    juce::MidiFile midiFile;
+    if (!stream.openedOk() || !midiFile.readFrom(stream)) {
+        return false;
+    }
+    midiFile.convertTimestampTicksToSeconds();
+    juce::MidiMessageSequence sequence;
+    for (int t = 0; t < midiFile.getNumTracks(); ++t) {
+        sequence.addSequence(*midiFile.getTrack(t), 0.0);
+    }
+    sequence.sort();
+    for (int i = 0; i < sequence.getNumEvents(); ++i) {
+        const auto &message = sequence.getEventPointer(i)->message;
+        if (message.isNoteOnOrOff()) {
+            events.push_back({ (juce::int64) std::llround(message.getTimeStamp() * sampleRate), message });
+        }
+    }
+    return true;
+}
+
+bool applySettings(StiffStringAudioProcessor &processor, const juce::StringPairArray &settings)
+{
+    for (auto &id : settings.getAllKeys()) {
+        auto *param = processor.getParams().getParameter(id);
+        if (param == nullptr) {
+            std::cerr << "Unknown parameter " << id << "\n";
+            return false;
+        }
+        const float value = settings[id].getFloatValue();
+        param->setValueNotifyingHost(param->convertTo0to1(value));
+    }
+    return true;
+}
+
+// Render the events through the plugin, timing processBlock alone
+void renderPlugin(StiffStringAudioProcessor &processor, const Options &options, const std::vector<Event> &events,
+                  juce::AudioBuffer<float> &output, double &seconds)
+{
+    processor.setNonRealtime(true);
+    processor.setRateAndBufferSizeDetails(options.sampleRate, options.blockSize);
+    processor.prepareToPlay(options.sampleRate, options.blockSize);
+
+    const int numChannels = output.getNumChannels();
+    const juce::int64 totalSamples = output.getNumSamples();
+    juce::AudioBuffer<float> buffer(numChannels, options.blockSize);
+    juce::MidiBuffer midi;
+    size_t nextEvent = 0;
+    seconds = 0.0;
+    for (juce::int64 position = 0; position < totalSamples; position += options.blockSize) {
+        const int numSamples = (int) juce::jmin((juce::int64) options.blockSize, totalSamples - position);
+        buffer.setSize(numChannels, numSamples, false, false, true);
+        midi.clear();
+        for (; nextEvent < events.size() && events[nextEvent].sample < position + numSamples; ++nextEvent) {
+            const auto offset = juce::jmax((juce::int64) 0, events[nextEvent].sample - position);
+            midi.addEvent(events[nextEvent].message, (int) offset);
+        }
+
+        const auto start = Clock::now();
+        processor.processBlock(buffer, midi);
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+        for (int ch = 0; ch < numChannels; ++ch) {
+            output.copyFrom(ch, (int) position, buffer, ch, 0, numSamples);
+        }
+    }
+    processor.releaseResources();
+}
+
+void renderReference(const StiffString::Parameters &params, int numModes, int numPickups, const Options &options,
+                     const std::vector<Event> &events, juce::AudioBuffer<double> &output, double &seconds)
+{
+    const auto start = Clock::now();
+    ReferenceRenderer reference(params, numModes, numPickups, options.sampleRate);
+    for (const auto &event : events) {
+        if (event.message.isNoteOn()) {
+            reference.noteOn(event.message.getChannel(), event.message.getNoteNumber(), event.sample);
+        } else if (event.message.isNoteOff()) {
+            reference.noteOff(event.message.getChannel(), event.message.getNoteNumber(), event.sample);
+        }
+    }
+    reference.render(output);
+    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double toDecibels(double ratio)
+{
+    return 20.0 * std::log10(juce::jmax(ratio, 1.0e-15));
+}
+
+struct Errors {
+    // peak error, relative to the peak of the reference
+    double maxErrorDb = -300.0;
+    // power of the reference over power of the error
+    double snrDb = 300.0;
+    // the worst frame's peak error bin, relative to its peak reference bin
+    double peakSpectralErrorDb = -300.0;
+    // RMS difference in level, over the audible bins of every frame
+    double logSpectralDistanceDb = 0.0;
+};
+
+// Time-domain and spectral error of one channel.  The spectra are taken
+// frame by frame with a Hann window; bins more than 80 dB below the peak of
+// their frame are left out of the log-spectral distance.
+Errors measureErrors(const float *fast, const double *reference, int numSamples)
+{
+    Errors errors;
+    double peak = 0.0, maxError = 0.0, signalPower = 0.0, errorPower = 0.0;
+    for (int i = 0; i < numSamples; ++i) {
+        const double e = (double) fast[i] - reference[i];
+        peak = juce::jmax(peak, std::abs(reference[i]));
+        maxError = juce::jmax(maxError, std::abs(e));
+        signalPower += reference[i] * reference[i];
+        errorPower += e * e;
+    }
+    errors.maxErrorDb = toDecibels(maxError / juce::jmax(peak, 1.0e-30));
+    errors.snrDb = 10.0 * std::log10(juce::jmax(signalPower, 1.0e-30) / juce::jmax(errorPower, 1.0e-30));
+
+    constexpr int fftOrder = 11;
+    constexpr int frameSize = 1 << fftOrder;
+    constexpr int hopSize = frameSize / 2;
+    constexpr int numBins = frameSize / 2 + 1;
+    juce::dsp::FFT fft(fftOrder);
+    juce::dsp::WindowingFunction<double> window((size_t) frameSize, juce::dsp::WindowingFunction<double>::hann, false);
+    std::vector<double> windowed((size_t) frameSize);
+    std::vector<float> refSpectrum(2 * frameSize), fastSpectrum(2 * frameSize), errorSpectrum(2 * frameSize);
+    double sumSquares = 0.0;
+    int numTerms = 0;
+    for (int start = 0; start + frameSize <= numSamples; start += hopSize) {
+        auto transform = [&](std::vector<float> &spectrum, auto &&sample) {
+            for (int i = 0; i < frameSize; ++i) {
+                windowed[(size_t) i] = sample(start + i);
+            }
+            window.multiplyWithWindowingTable(windowed.data(), (size_t) frameSize);
+            std::fill(spectrum.begin(), spectrum.end(), 0.0f);
+            std::copy(windowed.begin(), windowed.end(), spectrum.begin());
+            fft.performFrequencyOnlyForwardTransform(spectrum.data(), true);
+        };
+        transform(refSpectrum, [&](int i) { return reference[i]; });
+        transform(fastSpectrum, [&](int i) { return (double) fast[i]; });
+        transform(errorSpectrum, [&](int i) { return (double) fast[i] - reference[i]; });
+
+        const float refPeak = *std::max_element(refSpectrum.begin(), refSpectrum.begin() + numBins);
+        if (refPeak < 1.0e-6f) {
+            continue;  // silence
+        }
+        const float errorPeak = *std::max_element(errorSpectrum.begin(), errorSpectrum.begin() + numBins);
+        errors.peakSpectralErrorDb = juce::jmax(errors.peakSpectralErrorDb, toDecibels(errorPeak / refPeak));
+        for (int k = 0; k < numBins; ++k) {
+            if (refSpectrum[(size_t) k] > refPeak * 1.0e-4f) {
+                const double difference = toDecibels(fastSpectrum[(size_t) k] / refSpectrum[(size_t) k]);
+                sumSquares += difference * difference;
+                ++numTerms;
+            }
+        }
+    }
+    errors.logSpectralDistanceDb = numTerms > 0 ? std::sqrt(sumSquares / numTerms) : 0.0;
+    return errors;
+}
+
+juce::var runCase(const Case &testCase, const Options &options, const std::vector<Event> &events)
+{
+    StiffStringAudioProcessor processor;
+    // every note of the reference sounds for as long as it has to, and
+    // nothing else touches the strings
+    juce::StringPairArray settings;
+    settings.set("VOICES", "64");
+    settings.set("GOVERNOR", "0");
+    settings.set("RESONANCE", "0");
+    settings.addArray(testCase.settings);
+    settings.addArray(options.parameterValues);
+    if (!applySettings(processor, settings)) {
+        return {};
+    }
+    processor.applyPendingSettings();
+
+    const int numModes = (int) processor.getParams().getRawParameterValue("MODES")->load();
+    const int numChannels = processor.getTotalNumOutputChannels();
+    const int numPickups = juce::jlimit(1, ModalBank::maxPickups, numChannels);
+    const auto params = processor.readParameters();
+    const double tailSeconds = processor.getTailLengthSeconds();
+    const juce::int64 lastEvent = events.empty() ? 0 : events.back().sample;
+    const int totalSamples = (int) (lastEvent + (juce::int64) std::ceil(tailSeconds * options.sampleRate));
+
+    std::cerr << testCase.name << ": plugin...\n";
+    juce::AudioBuffer<float> fast(numChannels, totalSamples);
+    double pluginSeconds = 0.0;
+    renderPlugin(processor, options, events, fast, pluginSeconds);
+
+    std::cerr << testCase.name << ": reference...\n";
+    juce::AudioBuffer<double> reference(numChannels, totalSamples);
+    double referenceSeconds = 0.0;
+    renderReference(params, numModes, numPickups, options, events, reference, referenceSeconds);
+
+    // the worst of the channels
+    Errors worst;
+    for (int ch = 0; ch < numChannels; ++ch) {
+        const auto errors = measureErrors(fast.getReadPointer(ch), reference.getReadPointer(ch), totalSamples);
+        worst.maxErrorDb = juce::jmax(worst.maxErrorDb, errors.maxErrorDb);
+        worst.snrDb = juce::jmin(worst.snrDb, errors.snrDb);
+        worst.peakSpectralErrorDb = juce::jmax(worst.peakSpectralErrorDb, errors.peakSpectralErrorDb);
+        worst.logSpectralDistanceDb = juce::jmax(worst.logSpectralDistanceDb, errors.logSpectralDistanceDb);
+    }
+
+    auto *settingsObject = new juce::DynamicObject();
+    for (auto &id : settings.getAllKeys()) {
+        settingsObject->setProperty(id, settings[id]);
+    }
+    const double audioSeconds = totalSamples / options.sampleRate;
+    auto *result = new juce::DynamicObject();
+    result->setProperty("name", testCase.name);
+    result->setProperty("settings", juce::var(settingsObject));
+    result->setProperty("channels", numChannels);
+    result->setProperty("audioSeconds", audioSeconds);
+    result->setProperty("pluginSeconds", pluginSeconds);
+    result->setProperty("referenceSeconds", referenceSeconds);
+    result->setProperty("speedup", referenceSeconds / juce::jmax(pluginSeconds, 1.0e-9));
+    result->setProperty("realTimeFactor", audioSeconds / juce::jmax(pluginSeconds, 1.0e-9));
+    result->setProperty("maxErrorDb", worst.maxErrorDb);
+    result->setProperty("snrDb", worst.snrDb);
+    result->setProperty("peakSpectralErrorDb", worst.peakSpectralErrorDb);
+    result->setProperty("logSpectralDistanceDb", worst.logSpectralDistanceDb);
+    return juce::var(result);
+}
+
+bool parseArguments(const juce::StringArray &args, Options &options)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const auto &arg = args[i];
+        if (arg == "--quick") {
+            options.quick = true;
+            continue;
+        }
+        if (i + 1 >= args.size()) {
+            return false;
+        }
+        const auto value = args[++i];
+        const auto path = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+        if (arg == "--midi") {
+            options.midiFile = path;
+        } else if (arg == "--out") {
+            options.outputFile = path;
+        } else if (arg == "--case") {
+            options.caseName = value;
+        } else if (arg == "--set" && value.contains("=")) {
+            options.parameterValues.set(value.upToFirstOccurrenceOf("=", false, false),
+                                        value.fromFirstOccurrenceOf("=", false, false));
+        } else if (arg == "--rate") {
+            options.sampleRate = value.getDoubleValue();
+        } else if (arg == "--block") {
+            options.blockSize = value.getIntValue();
+        } else {
+            return false;
+        }
+    }
+    return options.sampleRate > 0.0 && options.blockSize > 0;
+}
+
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i) {
+        args.add(juce::CharPointer_UTF8(argv[i]));
+    }
+    Options options;
+    if (!parseArguments(args, options)) {
+        std::cout << "Usage: Accuracy [--out results.json] [--quick] [--case name] [--midi file.mid]\n"
+                     "                [--set ID=value]... [--rate Hz] [--block samples]\n"
+                     "Cases: time-domain, stiff, spectral, parallel (default: all).  --set applies\n"
+                     "to every case.  Only the notes of a MIDI file are played.\n";
+        return 1;
+    }
+
+    std::vector<Event> events;
+    if (options.midiFile != juce::File()) {
+        if (!loadMidiFile(options.midiFile, options.sampleRate, events)) {
+            std::cerr << "Could not read MIDI file " << options.midiFile.getFullPathName() << "\n";
+            return 1;
+        }
+    } else {
+        events = makeTestSequence(options.sampleRate, options.quick);
+    }
+
+    juce::Array<juce::var> results;
+    for (const auto &testCase : makeCases()) {
+        if (options.caseName.isEmpty() || options.caseName == testCase.name) {
+            auto result = runCase(testCase, options, events);
+            if (result.isVoid()) {
+                return 1;
+            }
+            results.add(result);
+        }
+    }
+    if (results.isEmpty()) {
+        std::cerr << "Unknown case " << options.caseName << "\n";
+        return 1;
+    }
+
+    auto *root = new juce::DynamicObject();
+    juce::var output(root);
+    root->setProperty("sampleRate", options.sampleRate);
+    root->setProperty("blockSize", options.blockSize);
+    root->setProperty("numEvents", (int) events.size());
+    root->setProperty("cases", results);
+
+    const auto json = juce::JSON::toString(output);
+    if (options.outputFile == juce::File()) {
+        std::cout << json << "\n";
+    } else if (!options.outputFile.replaceWithText(json)) {
+        std::cerr << "Could not write " << options.outputFile.getFullPathName() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+
+    ReferenceRenderer.cpp
+    Created: 17 Oct 2026 5:53:02am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#include "ReferenceRenderer.h"
+#include "../../../Source/SynthVoice.h"
+
+ReferenceRenderer::ReferenceRenderer(const StiffString::Parameters &params, int numModes, int numPickups,
+                                     double sampleRate) :
+    params(params),
+    numModes(numModes),
+    numPickups(numPickups),
+    sampleRate(sampleRate)
+{}
+
+void ReferenceRenderer::noteOn(int midiChannel, int midiNoteNumber, juce::int64 sample)
+{
+    // a repeated note damps the one before, as StringEngine does
+    noteOff(midiChannel, midiNoteNumber, sample);
+    notes.push_back({ midiChannel, midiNoteNumber, juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber),
+                      sample, std::numeric_limits<juce::int64>::max() });
+}
+
+void ReferenceRenderer::noteOff(int midiChannel, int midiNoteNumber, juce::int64 sample)
+{
+    for (auto &note : notes) {
+        if (note.channel == midiChannel && note.noteNumber == midiNoteNumber && note.release > sample) {
+            note.release = sample;
+        }
+    }
+}
+
+void ReferenceRenderer::render(juce::AudioBuffer<double> &output) const
+{
+    output.clear();
+    for (const auto &note : notes) {
+        renderNote(note, output);
+    }
+}
+
+void ReferenceRenderer::renderNote(const Note &note, juce::AudioBuffer<double> &output) const
+{
+    // The same model as StiffString::getModeCoefficient and
+    // getPluckAmplitude, in double precision throughout
+    constexpr double pi = juce::MathConstants<double>::pi;
+    const double radPerSample = juce::MathConstants<double>::twoPi * note.freqHz / sampleRate;
+    const double x0 = (double) params.pluckPos * 0.5 * pi;
+    const double kappaSq = (double) params.stiffness * (double) params.stiffness;
+    // the damper's decay per sample, after the release
+    const double damping = 1.0 / ((double) SynthVoice::releaseTime * sampleRate);
+
+    const int numChannels = output.getNumChannels();
+    const juce::int64 length = output.getNumSamples();
+    std::vector<double> gains((size_t) numChannels);
+    for (int n = 1; n <= numModes; ++n) {
+        const double nSq = (double) n * n;
+        const double sig = (double) params.decay + (double) params.decayHighFreq * nSq;
+        const double w0 = n * std::sqrt(1.0 + kappaSq * nSq);
+        const double zeta = sig / w0;
+        const double omega = w0 * std::sqrt(juce::jmax(0.0, 1.0 - zeta * zeta)) * radPerSample;
+        if (omega >= pi) {
+            continue;
+        }
+        const double decay = sig * radPerSample;
+        const double amplitude = SynthVoice::noteAmplitude * 2.0 * std::sin(x0 * n) / (nSq * x0 * (pi - x0));
+        double peakGain = 0.0;
+        for (int c = 0; c < numChannels; ++c) {
+            const double xp = (double) params.pickupPos[(size_t) (c % numPickups)] * 0.5 * pi;
+            gains[(size_t) c] = amplitude * std::sin(n * xp);
+            peakGain = juce::jmax(peakGain, std::abs(gains[(size_t) c]));
+        }
+
+        for (juce::int64 s = note.start; s < length; ++s) {
+            const double t = (double) (s - note.start);
+            const double released = s > note.release ? (double) (s - note.release) : 0.0;
+            const double envelope = std::exp(-decay * t - damping * released);
+            if (peakGain * envelope < floor) {
+                break;
+            }
+            const double value = envelope * std::sin(omega * t);
+            for (int c = 0; c < numChannels; ++c) {
+                output.getWritePointer(c)[s] += gains[(size_t) c] * value;
+            }
+        }
+    }
+}
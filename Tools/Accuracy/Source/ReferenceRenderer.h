@@ -0,0 +1,59 @@
+/*
+  ==============================================================================
+
+    ReferenceRenderer.h
+    Created: 17 Oct 2026 5:53:02am
+    Author:  Clancy Rowley
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../../Source/StiffString.h"
+
+// The plugin's modal model, rendered slowly and in double precision, as a
+// reference for the fast paths.  Each mode of each note is evaluated at
+// every sample from its closed form,
+//
+//     noteAmplitude * a_n * w_n * exp(-sigma_n t) * sin(omega_n t),
+//
+// rather than by recurrence, so no error builds up over a note.  Nothing is
+// culled but the modes at or above Nyquist, which the model leaves out.  A
+// note-off damps the note as SynthVoice does, and a repeated note damps the
+// one it replaces.  There are no pedals, wheels, sympathetic resonance or
+// voice limit: sequences to compare should only have notes, and no more at
+// once than the plugin has voices.
+class ReferenceRenderer {
+public:
+    ReferenceRenderer(const StiffString::Parameters &params, int numModes, int numPickups, double sampleRate);
+
+    // Events, in order of time
+    void noteOn(int midiChannel, int midiNoteNumber, juce::int64 sample);
+    void noteOff(int midiChannel, int midiNoteNumber, juce::int64 sample);
+
+    // Render every note into the buffer, which starts at sample zero.
+    // Channel c takes pickup c % numPickups.
+    void render(juce::AudioBuffer<double> &output) const;
+
+private:
+    struct Note {
+        int channel;
+        int noteNumber;
+        double freqHz;
+        juce::int64 start;
+        juce::int64 release;  // when the damper falls, or never
+    };
+
+    void renderNote(const Note &note, juce::AudioBuffer<double> &output) const;
+
+    // modes fainter than this at the output are left out from then on
+    static constexpr double floor = 1.0e-12;
+
+    const StiffString::Parameters params;
+    const int numModes;
+    const int numPickups;
+    const double sampleRate;
+    std::vector<Note> notes;
+};
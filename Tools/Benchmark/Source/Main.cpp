@@ -0,0 +1,351 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Created: 17 Oct 2026 4:37:29am
+    Author:  Clancy Rowley
+
+    Benchmarks for the modal synthesis hot path.  Results are written as
+    JSON, so that runs from different builds can be diffed.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/StiffString.h"
+#include "../../../Source/ModalTables.h"
+#include "../../../Source/VoiceArena.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    juce::File outputFile;
+    double minSeconds = 0.1;            // minimum time spent on each measurement
+    double targetSampleRate = 48000.0;  // target buffer, for the per-voice figures
+    int targetBlockSize = 64;
+    bool quick = false;
+};
+
+// Mean seconds per call of fn, called repeatedly for at least minSeconds
+template <typename Fn>
+double timePerCall(Fn &&fn, double minSeconds)
+{
+    constexpr int batch = 8;
+    fn();
+    int calls = 0;
+    double elapsed = 0.0;
+    const auto start = Clock::now();
+    do {
+        for (int i = 0; i < batch; ++i) {
+            fn();
+        }
+        calls += batch;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < minSeconds);
+    return elapsed / calls;
+}
+
+struct Leaf {
+    explicit Leaf(double sampleRate)
+    {
+        LEAF_init(&leaf, (float) sampleRate, memory, sizeof(memory), []() { return (float) rand() / RAND_MAX; });
+    }
+    char memory[32];
+    LEAF leaf;
+};
+
+// A single StiffString with its own arena, plucked with no decay, so that
+// every mode below Nyquist keeps running for the whole measurement
+struct PluckedString {
+    PluckedString(double sampleRate, int numModes, int numPickups = 1) :
+        leaf(sampleRate),
+        arena(1, StiffString::getStorageSize(numModes, numPickups)),
+        string(&leaf.leaf, numModes, numPickups, arena.getVoiceStorage(0))
+    {
+        string.setParameters(params, 0);
+        string.setInitialAmplitudes();
+        string.setFreq(freqHz);
+    }
+
+    static constexpr float freqHz = 20.0f;
+    Leaf leaf;
+    VoiceArena arena;
+    StiffString::Parameters params;
+    StiffString string;
+};
+
+juce::var makeResult(std::initializer_list<std::pair<const char *, juce::var>> fields)
+{
+    auto *object = new juce::DynamicObject();
+    for (auto &field : fields) {
+        object->setProperty(field.first, field.second);
+    }
+    return juce::var(object);
+}
+
+juce::var benchmarkRender(const Options &options, const juce::Array<double> &sampleRates,
+                          const juce::Array<int> &modeCounts, const juce::Array<int> &blockSizes)
+{
+    juce::Array<juce::var> results;
+    for (auto sampleRate : sampleRates) {
+        for (auto numModes : modeCounts) {
+            for (auto blockSize : blockSizes) {
+                PluckedString s(sampleRate, numModes);
+                std::vector<float> buffer((size_t) blockSize);
+                const double seconds = timePerCall([&] { s.string.renderBlock(buffer.data(), blockSize); },
+                                                   options.minSeconds);
+                const int activeModes = s.string.getNumActiveModes();
+                const double nsPerSample = seconds * 1.0e9 / blockSize;
+                results.add(makeResult({ { "sampleRate", sampleRate },
+                                         { "modes", numModes },
+                                         { "kernel", juce::String(s.string.getKernelName()) },
+                                         { "activeModes", activeModes },
+                                         { "blockSize", blockSize },
+                                         { "nsPerSample", nsPerSample },
+                                         { "nsPerSamplePerMode", nsPerSample / juce::jmax(1, activeModes) } }));
+            }
+        }
+    }
+    return results;
+}
+
+juce::var benchmarkNoteOn(const Options &options, const juce::Array<int> &modeCounts)
+{
+    juce::Array<juce::var> results;
+    for (auto numModes : modeCounts) {
+        PluckedString s(options.targetSampleRate, numModes);
+        float freqHz = PluckedString::freqHz;
+        const double seconds = timePerCall([&] {
+            s.string.setInitialAmplitudes();
+            s.string.setFreq(freqHz);
+            freqHz = freqHz < 1000.0f ? freqHz * 1.01f : PluckedString::freqHz;
+        }, options.minSeconds);
+
+        // the same, from tables built in the background
+        ModalTables tables;
+        tables.request(s.params, options.targetSampleRate, numModes, 1);
+        while (tables.getCurrent() == nullptr) {
+            juce::Thread::sleep(1);
+            tables.acquire();
+        }
+        const auto *table = tables.getCurrent();
+        int note = 0;
+        const double tableSeconds = timePerCall([&] {
+            s.string.pluck((float) juce::MidiMessage::getMidiNoteInHertz(note), table->getAmplitudes(),
+                           table->getCoefRe(note), table->getCoefIm(note));
+            note = (note + 1) % ModalTables::numNotes;
+        }, options.minSeconds);
+
+        results.add(makeResult({ { "modes", numModes },
+                                 { "noteOnNs", seconds * 1.0e9 },
+                                 { "noteOnFromTableNs", tableSeconds * 1.0e9 } }));
+    }
+    return results;
+}
+
+// Cost of rendering while parameters change every changeInterval blocks
+// (0 for never).  Changes alternate between the pickup position and the
+// stiffness, which between them touch every per-mode coefficient.
+juce::var benchmarkParameterChanges(const Options &options, const juce::Array<int> &modeCounts,
+                                    const juce::Array<int> &changeIntervals)
+{
+    juce::Array<juce::var> results;
+    const int blockSize = options.targetBlockSize;
+    for (auto numModes : modeCounts) {
+        for (auto interval : changeIntervals) {
+            PluckedString s(options.targetSampleRate, numModes);
+            std::vector<float> buffer((size_t) blockSize);
+            int block = 0;
+            int numChanges = 0;
+            const double seconds = timePerCall([&] {
+                if (interval > 0 && ++block % interval == 0) {
+                    if (++numChanges % 2 == 0) {
+                        s.params.pickupPos[0] = s.params.pickupPos[0] == 0.3f ? 0.31f : 0.3f;
+                    } else {
+                        s.params.stiffness = s.params.stiffness == 0.0f ? 0.001f : 0.0f;
+                    }
+                    s.string.setParameters(s.params, blockSize);
+                }
+                s.string.renderBlock(buffer.data(), blockSize);
+            }, options.minSeconds);
+            const double nsPerSample = seconds * 1.0e9 / blockSize;
+            results.add(makeResult({ { "modes", numModes },
+                                     { "changeIntervalBlocks", interval },
+                                     { "blockSize", blockSize },
+                                     { "nsPerSample", nsPerSample },
+                                     { "nsPerSamplePerMode", nsPerSample / juce::jmax(1, s.string.getNumActiveModes()) } }));
+        }
+    }
+    return results;
+}
+
+// Cost of each extra pickup, each to its own channel, at the target buffer
+juce::var benchmarkPickups(const Options &options, const juce::Array<int> &modeCounts,
+                           const juce::Array<int> &pickupCounts)
+{
+    juce::Array<juce::var> results;
+    const int blockSize = options.targetBlockSize;
+    for (auto numModes : modeCounts) {
+        for (auto numPickups : pickupCounts) {
+            PluckedString s(options.targetSampleRate, numModes, numPickups);
+            juce::AudioBuffer<float> buffer(numPickups, blockSize);
+            buffer.clear();
+            const double seconds = timePerCall([&] {
+                s.string.addBlock(buffer.getArrayOfWritePointers(), numPickups, blockSize, 1.0e-3f);
+            }, options.minSeconds);
+            const double nsPerSample = seconds * 1.0e9 / blockSize;
+            results.add(makeResult({ { "modes", numModes },
+                                     { "pickups", numPickups },
+                                     { "kernel", juce::String(s.string.getKernelName()) },
+                                     { "blockSize", blockSize },
+                                     { "nsPerSample", nsPerSample },
+                                     { "nsPerSamplePerMode", nsPerSample / juce::jmax(1, s.string.getNumActiveModes()) } }));
+        }
+    }
+    return results;
+}
+
+void setParameter(StiffStringAudioProcessor &processor, const juce::String &id, float value)
+{
+    auto *param = processor.getParams().getParameter(id);
+    jassert(param != nullptr);
+    param->setValueNotifyingHost(param->convertTo0to1(value));
+}
+
+// The whole processor, with numVoices notes held, at the target block size
+juce::var benchmarkVoices(const Options &options, const juce::Array<int> &voiceCounts,
+                          const juce::Array<int> &modeCounts)
+{
+    juce::Array<juce::var> results;
+    const int blockSize = options.targetBlockSize;
+    const double blockSeconds = blockSize / options.targetSampleRate;
+    for (auto numModes : modeCounts) {
+        for (auto numVoices : voiceCounts) {
+            StiffStringAudioProcessor processor;
+            setParameter(processor, "VOICES", (float) numVoices);
+            setParameter(processor, "MODES", (float) numModes);
+            setParameter(processor, "DECAY", 0.0f);
+            setParameter(processor, "DECAYHF", 0.0f);
+            // measure every mode, however heavy the load
+            setParameter(processor, "GOVERNOR", 0.0f);
+            processor.applyPendingSettings();
+            processor.setRateAndBufferSizeDetails(options.targetSampleRate, blockSize);
+            processor.prepareToPlay(options.targetSampleRate, blockSize);
+
+            juce::AudioBuffer<float> buffer(processor.getTotalNumOutputChannels(), blockSize);
+            juce::MidiBuffer midi;
+            for (int v = 0; v < numVoices; ++v) {
+                midi.addEvent(juce::MidiMessage::noteOn(1, 24 + v, 1.0f), 0);
+            }
+            processor.processBlock(buffer, midi);
+            midi.clear();
+
+            const double seconds = timePerCall([&] { processor.processBlock(buffer, midi); }, options.minSeconds);
+            processor.releaseResources();
+
+            const double secondsPerVoice = seconds / numVoices;
+            results.add(makeResult({ { "modes", numModes },
+                                     { "voices", numVoices },
+                                     { "blockSize", blockSize },
+                                     { "sampleRate", options.targetSampleRate },
+                                     { "blockUs", seconds * 1.0e6 },
+                                     { "deadlineFraction", seconds / blockSeconds },
+                                     { "voicesPerCore", blockSeconds / secondsPerVoice } }));
+        }
+    }
+    return results;
+}
+
+bool parseArguments(const juce::StringArray &args, Options &options)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const auto &arg = args[i];
+        if (arg == "--quick") {
+            options.quick = true;
+            continue;
+        }
+        if (i + 1 >= args.size()) {
+            return false;
+        }
+        const auto value = args[++i];
+        if (arg == "--out") {
+            options.outputFile = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+        } else if (arg == "--min-time") {
+            options.minSeconds = value.getDoubleValue();
+        } else if (arg == "--rate") {
+            options.targetSampleRate = value.getDoubleValue();
+        } else if (arg == "--block") {
+            options.targetBlockSize = value.getIntValue();
+        } else {
+            return false;
+        }
+    }
+    return options.minSeconds > 0.0 && options.targetSampleRate > 0.0 && options.targetBlockSize > 0;
+}
+
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i) {
+        args.add(juce::CharPointer_UTF8(argv[i]));
+    }
+    Options options;
+    if (!parseArguments(args, options)) {
+        std::cout << "Usage: Benchmark [--out results.json] [--quick] [--min-time seconds]\n"
+                     "                 [--rate Hz] [--block samples]\n"
+                     "--rate and --block set the target buffer for note-on, parameter\n"
+                     "change and voices-per-core measurements (default 48000 Hz, 64).\n";
+        return 1;
+    }
+
+    const juce::Array<double> sampleRates = options.quick ? juce::Array<double> { 48000.0 }
+                                                          : juce::Array<double> { 44100.0, 48000.0, 96000.0, 192000.0 };
+    const juce::Array<int> modeCounts = options.quick ? juce::Array<int> { 32, 128 }
+                                                      : juce::Array<int> { 16, 32, 64, 128, 256, 512 };
+    const juce::Array<int> blockSizes = options.quick ? juce::Array<int> { 64, 512 }
+                                                      : juce::Array<int> { 16, 32, 64, 128, 256, 512, 1024 };
+    const juce::Array<int> voiceCounts = options.quick ? juce::Array<int> { 1, 6 }
+                                                       : juce::Array<int> { 1, 6, 16, 32, 48 };
+    const juce::Array<int> changeIntervals { 0, 64, 8, 1 };
+    const juce::Array<int> pickupCounts = options.quick ? juce::Array<int> { 1, 2 }
+                                                        : juce::Array<int> { 1, 2, 4, 8 };
+
+    const PluckedString probe(options.targetSampleRate, 8);
+    const juce::String kernelName(probe.string.getKernelName());
+    std::cerr << "Kernel: " << kernelName << "\n";
+
+    auto *root = new juce::DynamicObject();
+    juce::var results(root);
+    root->setProperty("kernel", kernelName);
+    root->setProperty("cpu", juce::SystemStats::getCpuModel());
+    root->setProperty("numCpus", juce::SystemStats::getNumCpus());
+    root->setProperty("targetSampleRate", options.targetSampleRate);
+    root->setProperty("targetBlockSize", options.targetBlockSize);
+
+    std::cerr << "Rendering...\n";
+    root->setProperty("render", benchmarkRender(options, sampleRates, modeCounts, blockSizes));
+    std::cerr << "Note-on...\n";
+    root->setProperty("noteOn", benchmarkNoteOn(options, modeCounts));
+    std::cerr << "Parameter changes...\n";
+    root->setProperty("parameterChanges", benchmarkParameterChanges(options, modeCounts, changeIntervals));
+    std::cerr << "Pickups...\n";
+    root->setProperty("pickups", benchmarkPickups(options, modeCounts, pickupCounts));
+    std::cerr << "Voices...\n";
+    root->setProperty("voices", benchmarkVoices(options, voiceCounts, modeCounts));
+
+    const auto json = juce::JSON::toString(results);
+    if (options.outputFile == juce::File()) {
+        std::cout << json << "\n";
+    } else if (!options.outputFile.replaceWithText(json)) {
+        std::cerr << "Could not write " << options.outputFile.getFullPathName() << "\n";
+        return 1;
+    }
+    return 0;
+}
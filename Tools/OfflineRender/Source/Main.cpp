@@ -0,0 +1,237 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Created: 17 Oct 2026 4:36:12am
+    Author:  Clancy Rowley
+
+    Renders a Standard MIDI File through StiffStringAudioProcessor to a WAV
+    or FLAC file, as fast as the CPU allows.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/RealtimeWatchdog.h"
+
+namespace {
+
+struct Options {
+    juce::File midiFile;
+    juce::File outputFile;
+    juce::File presetFile;
+    juce::StringPairArray parameterValues;
+    double sampleRate = 48000.0;
+    int blockSize = 4096;
+    int bitDepth = 24;
+    double tailSeconds = -1.0;  // negative: use the processor's tail length
+};
+
+void printUsage()
+{
+    std::cout << "Usage: OfflineRender --midi <file.mid> --out <file.wav|file.flac> [options]\n"
+                 "\n"
+                 "Options:\n"
+                 "  --preset <file.xml>    plugin state, as saved by the plugin\n"
+                 "  --set <ID>=<value>     set a parameter (e.g. --set STIFFNESS=0.02), repeatable\n"
+                 "  --rate <Hz>            sample rate (default 48000)\n"
+                 "  --block <samples>      block size passed to processBlock (default 4096)\n"
+                 "  --bits <n>             output bit depth (default 24)\n"
+                 "  --tail <seconds>       time to render after the last MIDI event\n";
+}
+
+bool parseArguments(const juce::StringArray &args, Options &options)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const auto &arg = args[i];
+        if (i + 1 >= args.size()) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        const auto value = args[++i];
+        const auto path = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+
+        if (arg == "--midi") {
+            options.midiFile = path;
+        } else if (arg == "--out") {
+            options.outputFile = path;
+        } else if (arg == "--preset") {
+            options.presetFile = path;
+        } else if (arg == "--set" && value.contains("=")) {
+            options.parameterValues.set(value.upToFirstOccurrenceOf("=", false, false),
+                                        value.fromFirstOccurrenceOf("=", false, false));
+        } else if (arg == "--rate") {
+            options.sampleRate = value.getDoubleValue();
+        } else if (arg == "--block") {
+            options.blockSize = value.getIntValue();
+        } else if (arg == "--bits") {
+            options.bitDepth = value.getIntValue();
+        } else if (arg == "--tail") {
+            options.tailSeconds = value.getDoubleValue();
+        } else {
+            std::cerr << "Unknown option " << arg << "\n";
+            return false;
+        }
+    }
+    return options.midiFile != juce::File() && options.outputFile != juce::File()
+        && options.sampleRate > 0.0 && options.blockSize > 0;
+}
+
+bool loadMidiFile(const juce::File &file, juce::MidiMessageSequence &sequence)
+{
+    juce::FileInputStream stream(file);
+    juce::MidiFile midiFile;
+    if (!stream.openedOk() || !midiFile.readFrom(stream)) {
+        return false;
+    }
+    midiFile.convertTimestampTicksToSeconds();
+    for (int t = 0; t < midiFile.getNumTracks(); ++t) {
+        sequence.addSequence(*midiFile.getTrack(t), 0.0);
+    }
+    sequence.sort();
+    return true;
+}
+
+bool applyPreset(StiffStringAudioProcessor &processor, const Options &options)
+{
+    if (options.presetFile != juce::File()) {
+        auto xml = juce::XmlDocument::parse(options.presetFile);
+        if (xml == nullptr) {
+            std::cerr << "Could not read preset " << options.presetFile.getFullPathName() << "\n";
+            return false;
+        }
+        juce::MemoryBlock state;
+        juce::AudioProcessor::copyXmlToBinary(*xml, state);
+        processor.setStateInformation(state.getData(), (int) state.getSize());
+    }
+
+    for (auto &id : options.parameterValues.getAllKeys()) {
+        auto *param = processor.getParams().getParameter(id);
+        if (param == nullptr) {
+            std::cerr << "Unknown parameter " << id << "\n";
+            return false;
+        }
+        const float value = options.parameterValues[id].getFloatValue();
+        param->setValueNotifyingHost(param->convertTo0to1(value));
+    }
+
+    processor.applyPendingSettings();
+    return true;
+}
+
+std::unique_ptr<juce::AudioFormatWriter> createWriter(const Options &options, int numChannels)
+{
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+    auto *format = formats.findFormatForFileExtension(options.outputFile.getFileExtension());
+    if (format == nullptr) {
+        return nullptr;
+    }
+
+    options.outputFile.deleteFile();
+    auto stream = options.outputFile.createOutputStream();
+    if (stream == nullptr) {
+        return nullptr;
+    }
+    std::unique_ptr<juce::AudioFormatWriter> writer(
+        format->createWriterFor(stream.get(), options.sampleRate, (unsigned int) numChannels,
+                                options.bitDepth, {}, 0));
+    if (writer != nullptr) {
+        stream.release();  // now owned by the writer
+    }
+    return writer;
+}
+
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i) {
+        args.add(juce::CharPointer_UTF8(argv[i]));
+    }
+    Options options;
+    if (!parseArguments(args, options)) {
+        printUsage();
+        return 1;
+    }
+
+    juce::MidiMessageSequence sequence;
+    if (!loadMidiFile(options.midiFile, sequence)) {
+        std::cerr << "Could not read MIDI file " << options.midiFile.getFullPathName() << "\n";
+        return 1;
+    }
+
+    StiffStringAudioProcessor processor;
+    if (!applyPreset(processor, options)) {
+        return 1;
+    }
+    processor.setNonRealtime(true);
+    processor.setRateAndBufferSizeDetails(options.sampleRate, options.blockSize);
+    processor.prepareToPlay(options.sampleRate, options.blockSize);
+
+    const int numChannels = processor.getTotalNumOutputChannels();
+    auto fileWriter = createWriter(options, numChannels);
+    if (fileWriter == nullptr) {
+        std::cerr << "Could not create " << options.outputFile.getFullPathName() << "\n";
+        return 1;
+    }
+
+    // The file is written on a background thread, so rendering never waits
+    // on the disk unless the writer falls a long way behind.
+    juce::TimeSliceThread writerThread("Audio file writer");
+    writerThread.startThread();
+    auto writer = std::make_unique<juce::AudioFormatWriter::ThreadedWriter>(fileWriter.release(), writerThread,
+                                                                            8 * options.blockSize);
+
+    const double tailSeconds = options.tailSeconds >= 0.0 ? options.tailSeconds
+                                                          : processor.getTailLengthSeconds();
+    const auto totalSamples = (juce::int64) std::ceil((sequence.getEndTime() + tailSeconds) * options.sampleRate);
+
+    juce::AudioBuffer<float> buffer(numChannels, options.blockSize);
+    juce::MidiBuffer midi;
+    int nextEvent = 0;
+
+    const double startTime = juce::Time::getMillisecondCounterHiRes();
+    for (juce::int64 position = 0; position < totalSamples; position += options.blockSize) {
+        const int numSamples = (int) juce::jmin((juce::int64) options.blockSize, totalSamples - position);
+        buffer.setSize(numChannels, numSamples, false, false, true);
+
+        midi.clear();
+        for (; nextEvent < sequence.getNumEvents(); ++nextEvent) {
+            const auto &message = sequence.getEventPointer(nextEvent)->message;
+            const auto eventSample = (juce::int64) std::llround(message.getTimeStamp() * options.sampleRate);
+            if (eventSample >= position + numSamples) {
+                break;
+            }
+            if (!message.isMetaEvent()) {
+                midi.addEvent(message, (int) juce::jmax((juce::int64) 0, eventSample - position));
+            }
+        }
+
+        processor.processBlock(buffer, midi);
+        while (!writer->write(buffer.getArrayOfReadPointers(), numSamples)) {
+            juce::Thread::sleep(1);
+        }
+    }
+    writer.reset();  // flushes the rest of the file
+    const double elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 0.001;
+
+    processor.releaseResources();
+
+    const double audioSeconds = (double) totalSamples / options.sampleRate;
+    std::cout << "Rendered " << audioSeconds << " s of audio in " << elapsedSeconds << " s ("
+              << audioSeconds / juce::jmax(elapsedSeconds, 1.0e-9) << "x real time) to "
+              << options.outputFile.getFullPathName() << "\n";
+
+    // only counted in builds with STIFFSTRING_RT_WATCHDOG, such as the
+    // Watchdog configuration
+    if (const int violations = RealtimeWatchdog::getNumViolations(); violations > 0) {
+        std::cerr << violations << " real-time violations in processBlock\n";
+        return 2;
+    }
+    return 0;
+}
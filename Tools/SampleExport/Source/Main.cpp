@@ -0,0 +1,417 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Created: 17 Oct 2026 6:23:15am
+    Author:  Clancy Rowley
+
+    Exports a multisample library: every note of the keyboard, at each of a
+    set of velocity layers, for each of a set of presets, one audio file per
+    sample.  Notes are rendered on every core at once, each straight through
+    a SynthVoice of its own, and each ends when its voice has decayed to
+    silence.  The strings may be struck by a recorded excitation (a hammer,
+    mallet or bow) rather than plucked.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/SynthVoice.h"
+#include "../../../Source/VoiceArena.h"
+
+namespace {
+
+struct Options {
+    juce::File outputDirectory;
+    juce::File excitationFile;
+    juce::Array<juce::File> presetFiles;
+    juce::StringPairArray parameterValues;
+    juce::String format = "wav";
+    double sampleRate = 48000.0;
+    int blockSize = 4096;
+    int bitDepth = 24;
+    int numChannels = 2;
+    int lowestNote = 21;
+    int highestNote = 108;
+    int numLayers = 8;
+    double holdSeconds = 30.0;
+    float drive = 1.0f;
+    float pluckLevel = -1.0f;  // negative: 0 with an excitation, else 1
+    int numThreads = juce::SystemStats::getNumCpus();
+};
+
+void printUsage()
+{
+    std::cout << "Usage: SampleExport --out <directory> [options]\n"
+                 "\n"
+                 "Options:\n"
+                 "  --preset <file.xml>    plugin state, as saved by the plugin, repeatable;\n"
+                 "                         a directory adds every .xml file in it\n"
+                 "  --set <ID>=<value>     set a parameter in every preset, repeatable\n"
+                 "  --notes <low>-<high>   MIDI notes to render (default 21-108)\n"
+                 "  --layers <n>           velocity layers per note (default 8)\n"
+                 "  --hold <seconds>       longest time a key is held before its release (default 30)\n"
+                 "  --excitation <file>    audio to drive each string with, from its note-on\n"
+                 "  --drive <gain>         gain of the excitation (default 1)\n"
+                 "  --pluck <level>        level of the pluck, 0 to 1 (default 1, or 0 with an excitation)\n"
+                 "  --channels <n>         output channels, one pickup each (default 2)\n"
+                 "  --rate <Hz>            sample rate (default 48000)\n"
+                 "  --bits <n>             output bit depth (default 24)\n"
+                 "  --format <wav|flac>    output file format (default wav)\n"
+                 "  --threads <n>          rendering threads (default: one per core)\n";
+}
+
+bool parseArguments(const juce::StringArray &args, Options &options)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        const auto &arg = args[i];
+        if (i + 1 >= args.size()) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        const auto value = args[++i];
+        const auto path = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+
+        if (arg == "--out") {
+            options.outputDirectory = path;
+        } else if (arg == "--preset" && path.isDirectory()) {
+            auto files = path.findChildFiles(juce::File::findFiles, false, "*.xml");
+            files.sort();
+            options.presetFiles.addArray(files);
+        } else if (arg == "--preset") {
+            options.presetFiles.add(path);
+        } else if (arg == "--set" && value.contains("=")) {
+            options.parameterValues.set(value.upToFirstOccurrenceOf("=", false, false),
+                                        value.fromFirstOccurrenceOf("=", false, false));
+        } else if (arg == "--notes") {
+            options.lowestNote = value.upToFirstOccurrenceOf("-", false, false).getIntValue();
+            options.highestNote = value.contains("-") ? value.fromFirstOccurrenceOf("-", false, false).getIntValue()
+                                                      : options.lowestNote;
+        } else if (arg == "--layers") {
+            options.numLayers = value.getIntValue();
+        } else if (arg == "--hold") {
+            options.holdSeconds = value.getDoubleValue();
+        } else if (arg == "--excitation") {
+            options.excitationFile = path;
+        } else if (arg == "--drive") {
+            options.drive = value.getFloatValue();
+        } else if (arg == "--pluck") {
+            options.pluckLevel = value.getFloatValue();
+        } else if (arg == "--channels") {
+            options.numChannels = value.getIntValue();
+        } else if (arg == "--rate") {
+            options.sampleRate = value.getDoubleValue();
+        } else if (arg == "--bits") {
+            options.bitDepth = value.getIntValue();
+        } else if (arg == "--format") {
+            options.format = value.toLowerCase();
+        } else if (arg == "--threads") {
+            options.numThreads = value.getIntValue();
+        } else {
+            std::cerr << "Unknown option " << arg << "\n";
+            return false;
+        }
+    }
+    return options.outputDirectory != juce::File() && options.sampleRate > 0.0
+        && options.numChannels >= 1 && options.numChannels <= ModalBank::maxPickups
+        && options.lowestNote >= 0 && options.highestNote <= 127 && options.lowestNote <= options.highestNote
+        && options.numLayers >= 1 && options.numLayers <= 127 && options.holdSeconds >= 0.0
+        && options.numThreads >= 1;
+}
+
+// What a voice needs to play one preset
+struct Preset {
+    juce::String name;
+    StiffString::Parameters params;
+    int numModes;
+};
+
+// Read a preset through the plugin itself, so that it is interpreted just
+// as the plugin would
+bool loadPreset(const juce::File &file, const Options &options, Preset &preset)
+{
+    StiffStringAudioProcessor processor;
+    if (file != juce::File()) {
+        auto xml = juce::XmlDocument::parse(file);
+        if (xml == nullptr) {
+            std::cerr << "Could not read preset " << file.getFullPathName() << "\n";
+            return false;
+        }
+        juce::MemoryBlock state;
+        juce::AudioProcessor::copyXmlToBinary(*xml, state);
+        processor.setStateInformation(state.getData(), (int) state.getSize());
+    }
+
+    for (auto &id : options.parameterValues.getAllKeys()) {
+        auto *param = processor.getParams().getParameter(id);
+        if (param == nullptr) {
+            std::cerr << "Unknown parameter " << id << "\n";
+            return false;
+        }
+        const float value = options.parameterValues[id].getFloatValue();
+        param->setValueNotifyingHost(param->convertTo0to1(value));
+    }
+
+    preset.name = file != juce::File() ? file.getFileNameWithoutExtension() : juce::String("Default");
+    preset.params = processor.readParameters();
+    preset.numModes = juce::roundToInt(processor.getParams().getRawParameterValue("MODES")->load());
+    return true;
+}
+
+struct Leaf {
+    explicit Leaf(double sampleRate)
+    {
+        LEAF_init(&leaf, (float) sampleRate, memory, sizeof(memory), []() { return (float) rand() / RAND_MAX; });
+    }
+    char memory[32];
+    LEAF leaf;
+};
+
+// Read an excitation, mixed down to mono, scaled by the drive and resampled
+// to the sample rate, then padded with silence to whole blocks
+bool loadExcitation(const Options &options, juce::AudioFormatManager &formats, std::vector<float> &excitation)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(options.excitationFile));
+    if (reader == nullptr || reader->lengthInSamples <= 0 || reader->lengthInSamples > std::numeric_limits<int>::max()) {
+        std::cerr << "Could not read excitation " << options.excitationFile.getFullPathName() << "\n";
+        return false;
+    }
+    const int length = (int) reader->lengthInSamples;
+    const int numChannels = (int) reader->numChannels;
+    juce::AudioBuffer<float> file(numChannels, length);
+    reader->read(&file, 0, length, 0, true, true);
+    std::vector<float> mono((size_t) length);
+    for (int ch = 0; ch < numChannels; ++ch) {
+        juce::FloatVectorOperations::addWithMultiply(mono.data(), file.getReadPointer(ch),
+                                                     options.drive / (float) numChannels, length);
+    }
+
+    const double ratio = reader->sampleRate / options.sampleRate;
+    const int resampledLength = (int) std::ceil(length / ratio);
+    const int paddedLength = (resampledLength + options.blockSize - 1) / options.blockSize * options.blockSize;
+    excitation.assign((size_t) paddedLength, 0.0f);
+    // the interpolator reads a few samples past the end
+    mono.resize(mono.size() + 8, 0.0f);
+    juce::LagrangeInterpolator interpolator;
+    interpolator.process(ratio, mono.data(), excitation.data(), resampledLength);
+    return true;
+}
+
+// What the jobs share: read-only settings, the threads that write the files,
+// and the tally
+struct Export {
+    const Options &options;
+    juce::AudioFormat *format;
+    // padded to whole blocks; empty for a pluck
+    std::vector<float> excitation;
+    juce::OwnedArray<juce::TimeSliceThread> writerThreads;
+    std::atomic<int> nextWriterThread { 0 };
+    std::atomic<int> numFinished { 0 };
+    std::atomic<int> numFailed { 0 };
+    std::atomic<juce::int64> samplesRendered { 0 };
+    juce::CriticalSection errorLock;
+
+    void reportError(const juce::String &message)
+    {
+        const juce::ScopedLock lock(errorLock);
+        std::cerr << message << "\n";
+        ++numFailed;
+    }
+};
+
+// One note of one preset, rendered once and written at every velocity layer.
+// The string's level does not depend on the velocity, so the layers are the
+// same render at different gains.
+class NoteJob : public juce::ThreadPoolJob {
+public:
+    NoteJob(Export &exporter, const Preset &preset, int noteNumber) :
+        juce::ThreadPoolJob(preset.name + " " + juce::String(noteNumber)),
+        exporter(exporter),
+        preset(preset),
+        noteNumber(noteNumber)
+    {}
+
+    JobStatus runJob() override
+    {
+        const auto &options = exporter.options;
+        const int numChannels = options.numChannels;
+        const int blockSize = options.blockSize;
+
+        // Everything the voice touches belongs to this job, LEAF context
+        // included, so the jobs share nothing while they render
+        Leaf leaf(options.sampleRate);
+        VoiceArena arena(1, SynthVoice::getStorageSize(preset.numModes, numChannels));
+        SynthVoice voice(&leaf.leaf, preset.numModes, numChannels, arena.getVoiceStorage(0), nullptr);
+        voice.setCurrentPlaybackSampleRate(options.sampleRate);
+        voice.prepareToPlay(options.sampleRate, blockSize, numChannels);
+        voice.setParameters(preset.params, 0);
+        const auto &excitation = exporter.excitation;
+        const auto excitationLength = (juce::int64) excitation.size();
+        voice.setPluckLevel(options.pluckLevel >= 0.0f ? options.pluckLevel : excitation.empty() ? 1.0f : 0.0f);
+        voice.setDriven(!excitation.empty());
+
+        std::vector<std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter>> writers;
+        std::vector<float> gains;
+        for (int layer = 0; layer < options.numLayers; ++layer) {
+            const int velocity = juce::roundToInt(127.0 * (layer + 1) / options.numLayers);
+            auto writer = createWriter(velocity);
+            if (writer == nullptr) {
+                return jobHasFinished;
+            }
+            writers.push_back(std::move(writer));
+            gains.push_back((float) velocity / 127.0f);
+        }
+
+        voice.startNote(1, noteNumber, 1.0f, 0);
+        voice.setKeyDown(true);
+
+        // The voice frees itself once its output is bound to stay below
+        // -100 dB, which ends the file
+        const auto holdSamples = (juce::int64) std::ceil(options.holdSeconds * options.sampleRate);
+        juce::AudioBuffer<float> buffer(numChannels, blockSize);
+        juce::AudioBuffer<float> scaled(numChannels, blockSize);
+        juce::int64 position = 0;
+        while (voice.isVoiceActive() && !shouldExit()) {
+            if (voice.isKeyDown() && position >= holdSamples) {
+                voice.setKeyDown(false);
+                voice.stopNote(0.0f, true);
+            }
+            // once the excitation is over, the voice may decay and be freed
+            const float *input = position < excitationLength ? excitation.data() + position : nullptr;
+            voice.setDriven(input != nullptr);
+            buffer.clear();
+            voice.prepareBlock(blockSize);
+            voice.renderNextBlock(buffer.getArrayOfWritePointers(), numChannels, blockSize, input);
+
+            for (size_t layer = 0; layer < writers.size(); ++layer) {
+                for (int c = 0; c < numChannels; ++c) {
+                    juce::FloatVectorOperations::copyWithMultiply(scaled.getWritePointer(c), buffer.getReadPointer(c),
+                                                                  gains[layer], blockSize);
+                }
+                while (!writers[layer]->write(scaled.getArrayOfReadPointers(), blockSize)) {
+                    juce::Thread::sleep(1);
+                }
+            }
+            position += blockSize;
+        }
+        writers.clear();  // flushes the files
+
+        exporter.samplesRendered += position;
+        ++exporter.numFinished;
+        return jobHasFinished;
+    }
+
+private:
+    std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter> createWriter(int velocity)
+    {
+        const auto &options = exporter.options;
+        const auto noteName = juce::MidiMessage::getMidiNoteName(noteNumber, true, true, 3);
+        const auto file = options.outputDirectory.getChildFile(preset.name)
+                              .getChildFile(preset.name + "_" + juce::String(noteNumber).paddedLeft('0', 3) + "_"
+                                            + noteName + "_v" + juce::String(velocity).paddedLeft('0', 3) + "."
+                                            + options.format);
+        file.deleteFile();
+        auto stream = file.createOutputStream();
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+        if (stream != nullptr) {
+            writer.reset(exporter.format->createWriterFor(stream.get(), options.sampleRate,
+                                                          (unsigned int) options.numChannels, options.bitDepth,
+                                                          {}, 0));
+        }
+        if (writer == nullptr) {
+            exporter.reportError("Could not create " + file.getFullPathName());
+            return nullptr;
+        }
+        stream.release();  // now owned by the writer
+
+        // the writer threads take the files in turn
+        auto &thread = *exporter.writerThreads[exporter.nextWriterThread++ % exporter.writerThreads.size()];
+        return std::make_unique<juce::AudioFormatWriter::ThreadedWriter>(writer.release(), thread,
+                                                                         8 * options.blockSize);
+    }
+
+    Export &exporter;
+    const Preset &preset;
+    const int noteNumber;
+};
+
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i) {
+        args.add(juce::CharPointer_UTF8(argv[i]));
+    }
+    Options options;
+    if (!parseArguments(args, options)) {
+        printUsage();
+        return 1;
+    }
+
+    if (options.presetFiles.isEmpty()) {
+        options.presetFiles.add(juce::File());
+    }
+    std::vector<Preset> presets((size_t) options.presetFiles.size());
+    for (int i = 0; i < options.presetFiles.size(); ++i) {
+        if (!loadPreset(options.presetFiles[i], options, presets[(size_t) i])) {
+            return 1;
+        }
+    }
+
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+    Export exporter { options, formats.findFormatForFileExtension(options.format) };
+    if (exporter.format == nullptr) {
+        std::cerr << "Unknown file format " << options.format << "\n";
+        return 1;
+    }
+    if (options.excitationFile != juce::File() && !loadExcitation(options, formats, exporter.excitation)) {
+        return 1;
+    }
+    for (const auto &preset : presets) {
+        const auto directory = options.outputDirectory.getChildFile(preset.name);
+        if (!directory.createDirectory()) {
+            std::cerr << "Could not create " << directory.getFullPathName() << "\n";
+            return 1;
+        }
+    }
+
+    // Encoding and writing the files happens on threads of its own, a few
+    // of them so that FLAC encoding keeps up with the renderers
+    const int numWriterThreads = juce::jmax(1, options.numThreads / 4);
+    for (int i = 0; i < numWriterThreads; ++i) {
+        exporter.writerThreads.add(new juce::TimeSliceThread("Audio file writer " + juce::String(i + 1)))
+            ->startThread();
+    }
+
+    // Each note is a job, taken by whichever thread is free next.  Low notes
+    // ring longest, so they go first, and the short high notes fill in the
+    // gaps at the end.
+    const double startTime = juce::Time::getMillisecondCounterHiRes();
+    const int numJobs = (options.highestNote - options.lowestNote + 1) * (int) presets.size();
+    {
+        juce::ThreadPool pool(options.numThreads);
+        for (int note = options.lowestNote; note <= options.highestNote; ++note) {
+            for (const auto &preset : presets) {
+                pool.addJob(new NoteJob(exporter, preset, note), true);
+            }
+        }
+        while (pool.getNumJobs() > 0) {
+            juce::Thread::sleep(500);
+            std::cout << "\r" << exporter.numFinished.load() << " / " << numJobs << " notes" << std::flush;
+        }
+        std::cout << "\n";
+    }
+    exporter.writerThreads.clear();
+    const double elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 0.001;
+
+    const double audioSeconds = (double) exporter.samplesRendered.load() / options.sampleRate;
+    std::cout << "Rendered " << exporter.numFinished.load() << " notes (" << audioSeconds << " s of audio) at "
+              << options.numLayers << " velocity layers in " << elapsedSeconds << " s on " << options.numThreads
+              << " threads to " << options.outputDirectory.getFullPathName() << "\n";
+    return exporter.numFailed > 0 ? 1 : 0;
+}